@@ -0,0 +1,48 @@
+#include "damppi_core.h"
+
+void backoff_seed(backoff_t *b, const uint8_t mac[6], uint8_t salt) {
+  // FNV-1a over the MAC, so every device and every link gets its own jitter sequence
+  uint32_t h = 2166136261u ^ salt;
+
+  for (int i = 0; i < 6; i++) {
+    h = (h ^ mac[i]) * 16777619u;
+  }
+
+  b->rand = h ? h : 1;
+}
+
+static uint32_t backoff_rand(backoff_t *b) {
+  // xorshift32
+  b->rand ^= b->rand << 13;
+  b->rand ^= b->rand >> 17;
+  b->rand ^= b->rand << 5;
+  return b->rand;
+}
+
+int backoff_next(backoff_t *b, int64_t now) {
+  if (b->up_since && now - b->up_since >= (int64_t)b->healthy_ms * 1000) {
+    b->attempt = 0;
+    b->resets++;
+  }
+
+  b->up_since = 0;
+
+  int64_t cap = (int64_t)b->base_ms << (b->attempt < 20 ? b->attempt : 20);
+
+  if (cap > b->max_ms) {
+    cap = b->max_ms;
+  } else {
+    b->attempt++;
+  }
+
+  // full jitter: anywhere up to the cap, which spreads a fleet that lost the link at the same instant
+  b->delay_ms = backoff_rand(b) % (uint32_t)(cap + 1);
+  b->attempts++;
+
+  return b->delay_ms;
+}
+
+void backoff_up(backoff_t *b, int64_t now) {
+  b->up_since = now;
+  b->connects++;
+}
@@ -0,0 +1,338 @@
+// Times the hot paths of damppi_core on the host and prints the cost per call as JSON, one line per case:
+//   {"case": "url_decode", "ns_per_op": 41.2, "ops": 1000000}
+// The glyph cases draw from a synthetic store of every Hangul syllable and also print the cache hit rate.
+// The numbers are for spotting regressions between builds on one machine; the pager's RISC-V core at 160 MHz
+// is roughly 20 to 50 times slower.
+//   bench [ops]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "damppi_core.h"
+
+// results go here so the compiler cannot drop the calls
+static volatile uint32_t sink;
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void report(const char *name, long ops, int64_t ns) {
+  printf("{\"case\": \"%s\", \"ns_per_op\": %.1f, \"ops\": %ld}\n", name, (double)ns / ops, ops);
+}
+
+static void report_cache(const char *name, const glyph_cache_t *cache) {
+  uint32_t total = cache->hits + cache->misses;
+
+  printf("{\"case\": \"%s\", \"hits\": %u, \"misses\": %u, \"evictions\": %u, \"hit_rate\": %.3f}\n", name,
+    cache->hits, cache->misses, cache->evictions, total ? (double)cache->hits / total : 0);
+}
+
+#define BENCH(name, ops, body)              \
+  do {                                      \
+    int64_t _start = now_ns();              \
+    for (long i = 0; i < (ops); i++) {      \
+      body;                                 \
+    }                                       \
+    report(name, ops, now_ns() - _start);   \
+  } while (0)
+
+static void bench_parsers(long ops) {
+  static const char form[] = "ssid=Office+WLAN&pass=s%C3%A9cr%C3%A8t%21&name=%EC%A3%BC%EB%B0%A9";
+  char buf[sizeof(form)];
+
+  BENCH("url_decode", ops, {
+    memcpy(buf, form, sizeof(form));
+    url_decode_inplace(buf);
+    sink += buf[0];
+  });
+
+  static const uint8_t query[] = { 0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f,
+    'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'v', 'i', 't', 'y', 'c', 'h', 'k', 0x05, 'a', 'p', 'p', 'l', 'e',
+    0x03, 'c', 'o', 'm', 0x00, 0x00, 0x01, 0x00, 0x01 };
+  static const uint8_t ip[4] = { 192, 168, 4, 1 };
+  uint8_t tx[512];
+
+  BENCH("dns_reply", ops, sink += dns_reply(query, sizeof(query), tx, sizeof(tx), ip));
+
+  char msg[64];
+
+  BENCH("msg_format", ops, sink += msg_format(msg, sizeof(msg), "%s %s", "\xec\xa3\xbc\xeb\xb0\xa9", "calls"));
+  BENCH("msg_format_truncated", ops, sink += msg_format(msg, 8, "%s", "\xec\xa3\xbc\xeb\xb0\xa9\xec\xa3\xbc"));
+
+  char json[128];
+
+  BENCH("json_escape", ops, sink += json_escape(json, sizeof(json), "Front \"desk\"\n\\ kitchen"));
+}
+
+static void bench_calls(long ops) {
+  btn_state_t btn = { 0 };
+
+  // one press every 300 ms with a bounce, so every branch is taken
+  BENCH("btn_event", ops, sink += btn_event(&btn, i * 150000LL + 1000000, i % 2));
+
+  bucket_t bucket = { .burst = 3, .refill_ms = 10000 };
+
+  BENCH("bucket_take", ops, sink += bucket_take(&bucket, i * 1000LL + 1));
+
+  coalesce_t coalesce = { .window_ms = 5000 };
+
+  // senders beyond COALESCE_SENDERS keep evicting, as in a busy fleet
+  BENCH("coalesce_check", ops, sink += coalesce_check(&coalesce, i % (COALESCE_SENDERS + 4), i * 1000LL + 1));
+
+  static replay_t replay;
+  uint8_t mac[6] = { 0x40, 0x4c, 0xca, 0, 0, 0 };
+
+  BENCH("replay_check", ops, {
+    mac[5] = i % 8;
+    sink += replay_check(&replay, mac, 7, i / 8);
+  });
+
+  backoff_t backoff = { .base_ms = 1000, .max_ms = 60000, .healthy_ms = 30000 };
+  backoff_seed(&backoff, mac, 0);
+
+  BENCH("backoff_next", ops, sink += backoff_next(&backoff, i * 1000LL));
+}
+
+static void bench_glyph(long ops) {
+  // a 24x24 glyph of short runs, about what a Hangul syllable at 30 px compresses to
+  enum { W = 24, H = 24 };
+  uint8_t rle[W * H], out[W * H];
+  int len = 0;
+
+  for (int px = 0; px < W * H;) {
+    int run    = 1 + (px * 7) % 6;
+    run        = run > W * H - px ? W * H - px : run;
+    rle[len++] = ((px / 5) % 16) << 4 | (run - 1);
+    px += run;
+  }
+
+  BENCH("glyph_rle_decode", ops / 10, sink += glyph_rle_decode(rle, len, out, W, H, W));
+
+  static glyph_cache_t cache;
+
+  // a working set slightly larger than the cache
+  BENCH("glyph_cache", ops, {
+    uint32_t key = 1 + i % (GLYPH_CACHE_SLOTS + 4);
+
+    if (!glyph_cache_get(&cache, key)) {
+      sink += glyph_cache_put(&cache, key, W * H)[0];
+    }
+  });
+}
+
+#define HANGUL_FIRST 0xAC00
+#define HANGUL_COUNT 11172
+
+static void wr16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+  wr16(p, v);
+  wr16(p + 2, v >> 16);
+}
+
+// a glyph store like tools/mkfont.py writes for the default sizes: every Hangul syllable at 24 and 30 px. The
+// glyphs of a size share one bitmap of short runs, which costs the same to decode as a real one.
+static uint8_t *font_image(uint32_t *size) {
+  static const int sizes[] = { 24, 30 };
+  enum { FONTS = 2 };
+
+  uint32_t index = FONTSTORE_HDR_LEN + FONTS * FONTSTORE_FONT_LEN;
+  uint32_t data  = index + FONTS * HANGUL_COUNT * FONTSTORE_GLYPH_LEN;
+  uint8_t *img   = calloc(1, data + FONTS * 30 * 30);
+  uint32_t end   = data;
+
+  memcpy(img, FONTSTORE_MAGIC, 4);
+  wr16(img + 4, FONTSTORE_VERSION);
+  wr16(img + 6, FONTS);
+
+  for (int i = 0; i < FONTS; i++) {
+    int px     = sizes[i];
+    uint8_t *f = img + FONTSTORE_HDR_LEN + i * FONTSTORE_FONT_LEN;
+    uint32_t glyph = end;
+
+    for (int p = 0; p < px * px;) {
+      int run     = 1 + (p * 7) % 6;
+      run         = run > px * px - p ? px * px - p : run;
+      img[end++]  = ((p / 5) % 16) << 4 | (run - 1);
+      p += run;
+    }
+
+    f[0] = px;
+    f[1] = px + px / 4;
+    f[2] = (uint8_t)-(px / 6);
+    wr32(f + 4, HANGUL_COUNT);
+    wr32(f + 8, index + i * HANGUL_COUNT * FONTSTORE_GLYPH_LEN);
+
+    for (int n = 0; n < HANGUL_COUNT; n++) {
+      uint8_t *g = img + index + (i * HANGUL_COUNT + n) * FONTSTORE_GLYPH_LEN;
+      wr32(g, HANGUL_FIRST + n);
+      wr32(g + 4, glyph);
+      wr16(g + 8, end - glyph);
+      g[10] = px;
+      g[11] = px;
+      g[14] = px;
+    }
+  }
+
+  *size = end;
+  return img;
+}
+
+// draws a glyph the way store_glyph_bitmap() in main/font.c does: from the cache, or decoded into it first
+static bool render(const fontstore_t *store, const fontstore_font_t *f, glyph_cache_t *cache, uint32_t cp,
+  uint8_t *out, int pitch) {
+  fontstore_glyph_t g;
+
+  if (!fontstore_find(store, f, cp, &g)) {
+    return false;
+  }
+
+  uint32_t key          = (uint32_t)f->size << 24 | g.cp;
+  const uint8_t *cached = glyph_cache_get(cache, key);
+
+  if (!cached) {
+    uint8_t *slot = glyph_cache_put(cache, key, g.box_w * g.box_h);
+
+    if (!slot) {
+      return glyph_rle_decode(g.data, g.len, out, g.box_w, g.box_h, pitch);
+    }
+
+    if (!glyph_rle_decode(g.data, g.len, slot, g.box_w, g.box_h, g.box_w)) {
+      glyph_cache_drop(cache, key);
+      return false;
+    }
+
+    cached = slot;
+  }
+
+  for (int y = 0; y < g.box_h; y++) {
+    memcpy(out + y * pitch, cached + y * g.box_w, g.box_w);
+  }
+
+  return true;
+}
+
+// a pager shows the names of a few dozen colleagues, some far more often than others
+#define NAMES 40
+#define NAME_LEN 3
+
+static uint32_t name_cp(int name, int i) {
+  return HANGUL_FIRST + (uint32_t)(name * 2654435761u + i * 40503u) % HANGUL_COUNT;
+}
+
+static int pick_name(uint32_t *rand) {
+  // xorshift32, then a skew towards low indexes
+  *rand ^= *rand << 13;
+  *rand ^= *rand >> 17;
+  *rand ^= *rand << 5;
+  uint32_t r = *rand % (NAMES * NAMES);
+
+  int n = 0;
+  while ((uint32_t)(n + 1) * (n + 1) <= r) {
+    n++;
+  }
+
+  return NAMES - 1 - n;
+}
+
+static void bench_font(long ops) {
+  uint32_t size;
+  uint8_t *img = font_image(&size);
+  fontstore_t store;
+
+  if (fontstore_open(&store, img, size) != 0) {
+    fprintf(stderr, "bad font image\n");
+    exit(1);
+  }
+
+  const fontstore_font_t *f = fontstore_font(&store, 30);
+  fontstore_glyph_t g;
+
+  BENCH("glyph_lookup", ops, sink += fontstore_find(&store, f, HANGUL_FIRST + (i * 7919) % HANGUL_COUNT, &g));
+
+  // the label's draw buffer, 4-byte aligned rows as LVGL would give
+  static uint8_t out[32 * 32];
+  static glyph_cache_t cache;
+  int pitch = 32;
+
+  // the same glyph over and over, then a new one every time
+  memset(&cache, 0, sizeof(cache));
+  BENCH("glyph_render_hit", ops / 10, sink += render(&store, f, &cache, HANGUL_FIRST, out, pitch));
+  memset(&cache, 0, sizeof(cache));
+  BENCH("glyph_render_miss", ops / 10,
+    sink += render(&store, f, &cache, HANGUL_FIRST + (i * 7919) % HANGUL_COUNT, out, pitch));
+
+  // calls from a skewed set of names, at both sizes the call screen uses
+  const fontstore_font_t *small = fontstore_font(&store, 24);
+  uint32_t rand                 = 1;
+  memset(&cache, 0, sizeof(cache));
+
+  BENCH("glyph_render_names", ops / 10, {
+    int name = pick_name(&rand);
+
+    for (int c = 0; c < NAME_LEN; c++) {
+      sink += render(&store, c % 2 ? small : f, &cache, name_cp(name, c), out, pitch);
+    }
+  });
+  report_cache("glyph_cache_names", &cache);
+
+  free(img);
+}
+
+static void bench_bus(long ops) {
+  uint32_t item = 0;
+
+  static uint8_t spsc_buf[64 * 8];
+  spsc_t spsc;
+  spsc_init(&spsc, spsc_buf, 8, 64);
+
+  BENCH("spsc_push_pop", ops, {
+    spsc_push(&spsc, &item);
+    sink += spsc_pop(&spsc, &item);
+  });
+
+  static uint32_t mpsc_buf[MPSC_BUF_SIZE(8, 64) / 4];
+  mpsc_t mpsc;
+  mpsc_init(&mpsc, mpsc_buf, 8, 64);
+
+  BENCH("mpsc_push_pop", ops, {
+    mpsc_push(&mpsc, &item);
+    sink += mpsc_pop(&mpsc, &item);
+  });
+
+  // the size of main.h's device_state_t
+  enum { STATE = 33 + 32 + 16 + 16 + 128 };
+  static uint32_t snap_buf[SNAP_BUF_SIZE(STATE) / 4];
+  uint8_t state[STATE] = { 0 };
+  snap_t snap;
+  snap_init(&snap, snap_buf, STATE, state);
+
+  BENCH("snap_publish", ops, {
+    state[0] = i;
+    snap_publish(&snap, state);
+  });
+  BENCH("snap_read", ops, {
+    snap_read(&snap, state);
+    sink += state[0];
+  });
+}
+
+int main(int argc, char **argv) {
+  long ops = argc > 1 ? atol(argv[1]) : 1000000;
+
+  bench_parsers(ops);
+  bench_calls(ops);
+  bench_glyph(ops);
+  bench_font(ops);
+  bench_bus(ops);
+
+  return 0;
+}
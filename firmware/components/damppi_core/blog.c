@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "damppi_core.h"
+
+void blog_rec_begin(blog_rec_t *r, uint8_t level, const char *tag, const char *fmt, uint32_t time_ms) {
+  uint32_t tag_addr = (uint32_t)(uintptr_t)tag;
+  uint32_t fmt_addr = (uint32_t)(uintptr_t)fmt;
+
+  r->buf[2] = level;
+  r->buf[3] = 0;
+  memcpy(r->buf + 4, &tag_addr, 4);
+  memcpy(r->buf + 8, &fmt_addr, 4);
+  memcpy(r->buf + 12, &time_ms, 4);
+  r->len = BLOG_HDR_LEN;
+}
+
+// an argument that does not fit ends the record; the decoder shows the rest as missing
+static bool blog_fits(blog_rec_t *r, uint32_t len) {
+  if (r->buf[3] || r->len + len > BLOG_REC_MAX) {
+    r->buf[3] = 1;
+    return false;
+  }
+
+  return true;
+}
+
+void blog_put_u32(blog_rec_t *r, uint32_t v) {
+  if (blog_fits(r, 4)) {
+    memcpy(r->buf + r->len, &v, 4);
+    r->len += 4;
+  }
+}
+
+void blog_put_u64(blog_rec_t *r, uint64_t v) {
+  if (blog_fits(r, 8)) {
+    memcpy(r->buf + r->len, &v, 8);
+    r->len += 8;
+  }
+}
+
+void blog_put_f64(blog_rec_t *r, double v) {
+  if (blog_fits(r, 8)) {
+    memcpy(r->buf + r->len, &v, 8);
+    r->len += 8;
+  }
+}
+
+void blog_put_str(blog_rec_t *r, const char *s) {
+  uint32_t len = s ? strnlen(s, BLOG_STR_MAX) : 0;
+
+  if (blog_fits(r, 1 + len)) {
+    r->buf[r->len++] = len;
+    memcpy(r->buf + r->len, s, len);
+    r->len += len;
+  }
+}
+
+void blog_ring_init(blog_ring_t *r, void *buf, uint32_t cap) {
+  *r = (blog_ring_t){ .buf = buf, .cap = cap };
+}
+
+static void blog_ring_read(const blog_ring_t *r, uint32_t pos, uint8_t *out, uint32_t len) {
+  uint32_t at    = pos % r->cap;
+  uint32_t first = len < r->cap - at ? len : r->cap - at;
+
+  memcpy(out, r->buf + at, first);
+  memcpy(out + first, r->buf, len - first);
+}
+
+void blog_ring_put(blog_ring_t *r, blog_rec_t *rec) {
+  uint16_t size = rec->len;
+  memcpy(rec->buf, &size, 2);
+
+  // make room by dropping whole records from the old end
+  while (r->head + size - r->tail > r->cap) {
+    uint16_t old;
+    blog_ring_read(r, r->tail, (uint8_t *)&old, 2);
+    r->tail += old;
+    r->dropped++;
+  }
+
+  uint32_t at    = r->head % r->cap;
+  uint32_t first = size < r->cap - at ? size : r->cap - at;
+
+  memcpy(r->buf + at, rec->buf, first);
+  memcpy(r->buf, rec->buf + first, size - first);
+
+  r->head += size;
+  r->records++;
+}
+
+uint32_t blog_ring_copy(const blog_ring_t *r, uint8_t *out, uint32_t cap) {
+  uint32_t len = r->head - r->tail;
+
+  if (len > cap) {
+    return 0;
+  }
+
+  blog_ring_read(r, r->tail, out, len);
+  return len;
+}
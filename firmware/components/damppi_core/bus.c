@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include "damppi_core.h"
+
+void spsc_init(spsc_t *r, void *buf, uint32_t size, uint32_t cap) {
+  *r = (spsc_t){ .buf = buf, .size = size, .cap = cap };
+}
+
+bool spsc_push(spsc_t *r, const void *item) {
+  uint32_t tail = r->tail;
+
+  if (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->cap) {
+    return false;
+  }
+
+  memcpy(r->buf + (tail & (r->cap - 1)) * r->size, item, r->size);
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+bool spsc_pop(spsc_t *r, void *item) {
+  uint32_t head = r->head;
+
+  if (head == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  memcpy(item, r->buf + (head & (r->cap - 1)) * r->size, r->size);
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+// every cell is a sequence number followed by the item; the sequence tells whose turn the cell is
+static uint32_t *mpsc_seq(const mpsc_t *r, uint32_t pos) {
+  return (uint32_t *)(r->buf + (pos & (r->cap - 1)) * MPSC_STRIDE(r->size));
+}
+
+void mpsc_init(mpsc_t *r, void *buf, uint32_t size, uint32_t cap) {
+  *r = (mpsc_t){ .buf = buf, .size = size, .cap = cap };
+
+  for (uint32_t i = 0; i < cap; i++) {
+    *mpsc_seq(r, i) = i;
+  }
+}
+
+bool mpsc_push(mpsc_t *r, const void *item) {
+  uint32_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  uint32_t *seq;
+
+  // claim a cell; a producer that loses the race retries with the position the winner left
+  while (true) {
+    seq          = mpsc_seq(r, pos);
+    int32_t diff = (int32_t)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - pos);
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  memcpy(seq + 1, item, r->size);
+  __atomic_store_n(seq, pos + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+bool mpsc_pop(mpsc_t *r, void *item) {
+  uint32_t pos  = r->head;
+  uint32_t *seq = mpsc_seq(r, pos);
+
+  // empty, or the producer that claimed this cell has not finished writing it
+  if (__atomic_load_n(seq, __ATOMIC_ACQUIRE) != pos + 1) {
+    return false;
+  }
+
+  memcpy(item, seq + 1, r->size);
+  __atomic_store_n(seq, pos + r->cap, __ATOMIC_RELEASE);
+  r->head = pos + 1;
+
+  return true;
+}
+
+// slots are copied with relaxed atomic accesses: a reader may overlap a writer, and finds out from gen afterwards
+static void snap_copy(uint8_t *dst, const uint8_t *src, uint32_t size) {
+  uint32_t words = size / 4;
+
+  for (uint32_t i = 0; i < words; i++) {
+    __atomic_store_n((uint32_t *)dst + i, __atomic_load_n((const uint32_t *)src + i, __ATOMIC_RELAXED),
+      __ATOMIC_RELAXED);
+  }
+
+  for (uint32_t i = words * 4; i < size; i++) {
+    __atomic_store_n(dst + i, __atomic_load_n(src + i, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  }
+}
+
+static uint8_t *snap_slot(const snap_t *s, uint32_t slot) {
+  return s->buf + slot * SNAP_STRIDE(s->size);
+}
+
+void snap_init(snap_t *s, void *buf, uint32_t size, const void *initial) {
+  *s = (snap_t){ .buf = buf, .size = size };
+
+  memcpy(snap_slot(s, 0), initial, size);
+  s->gen[0] = 2;
+}
+
+void snap_publish(snap_t *s, const void *state) {
+  uint32_t n, slot;
+
+  // claim a slot that is neither the published one nor being written by another writer
+  while (true) {
+    n            = __atomic_add_fetch(&s->next, 1, __ATOMIC_RELAXED);
+    slot         = n % SNAP_SLOTS;
+    uint32_t cur = __atomic_load_n(&s->cur, __ATOMIC_RELAXED);
+    uint32_t gen = __atomic_load_n(&s->gen[slot], __ATOMIC_RELAXED);
+
+    if (slot != cur % SNAP_SLOTS && !(gen & 1) &&
+        __atomic_compare_exchange_n(&s->gen[slot], &gen, 2 * n + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  // odd while the copy is being written, so a reader that raced it retries
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  snap_copy(snap_slot(s, slot), state, s->size);
+  __atomic_store_n(&s->gen[slot], 2 * n + 2, __ATOMIC_RELEASE);
+
+  // cur packs the publish number and its slot; a slower writer with an older copy must not hide a newer one
+  uint32_t cur  = __atomic_load_n(&s->cur, __ATOMIC_RELAXED);
+  uint32_t mine = n * SNAP_SLOTS + slot;
+
+  while ((int32_t)(n - cur / SNAP_SLOTS) > 0 &&
+         !__atomic_compare_exchange_n(&s->cur, &cur, mine, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+  }
+}
+
+void snap_read(snap_t *s, void *out) {
+  while (true) {
+    uint32_t cur  = __atomic_load_n(&s->cur, __ATOMIC_ACQUIRE);
+    uint32_t slot = cur % SNAP_SLOTS;
+    uint32_t gen  = __atomic_load_n(&s->gen[slot], __ATOMIC_ACQUIRE);
+
+    // the slot was already reused by a newer publish; pick that one up instead
+    if (gen != 2 * (cur / SNAP_SLOTS) + 2) {
+      continue;
+    }
+
+    snap_copy(out, snap_slot(s, slot), s->size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&s->gen[slot], __ATOMIC_RELAXED) == gen) {
+      return;
+    }
+  }
+}
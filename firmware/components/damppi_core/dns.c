@@ -0,0 +1,39 @@
+#include <string.h>
+
+#include "damppi_core.h"
+
+#define DNS_HDR_LEN 12
+#define DNS_ANSWER_LEN 16
+
+int dns_reply(const uint8_t *rx, int len, uint8_t *tx, int cap, const uint8_t ip[4]) {
+  if (len < DNS_HDR_LEN || len > cap - DNS_ANSWER_LEN) {
+    return -1;
+  }
+
+  memcpy(tx, rx, len);
+  tx[2] = 0x81;
+  tx[3] = 0x80;  // response, no error
+  tx[6] = 0x00;
+  tx[7] = 0x01;                            // ANCOUNT=1
+  tx[8] = tx[9] = tx[10] = tx[11] = 0x00;  // NS/AR=0
+
+  int p   = len;
+  tx[p++] = 0xC0;
+  tx[p++] = 0x0C;  // NAME ptr
+  tx[p++] = 0x00;
+  tx[p++] = 0x01;  // TYPE A
+  tx[p++] = 0x00;
+  tx[p++] = 0x01;  // CLASS IN
+  tx[p++] = 0x00;
+  tx[p++] = 0x00;
+  tx[p++] = 0x00;
+  tx[p++] = 0x3C;  // TTL
+  tx[p++] = 0x00;
+  tx[p++] = 0x04;  // RDLENGTH
+  tx[p++] = ip[0];
+  tx[p++] = ip[1];
+  tx[p++] = ip[2];
+  tx[p++] = ip[3];
+
+  return p;
+}
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "damppi_core.h"
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t rd16(const uint8_t *p) {
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+int fontstore_open(fontstore_t *store, const uint8_t *base, uint32_t size) {
+  memset(store, 0, sizeof(*store));
+
+  if (size < FONTSTORE_HDR_LEN || memcmp(base, FONTSTORE_MAGIC, 4) || rd16(base + 4) != FONTSTORE_VERSION) {
+    return -1;
+  }
+
+  int count = rd16(base + 6);
+
+  if (count > FONTSTORE_MAX_FONTS || (uint32_t)(FONTSTORE_HDR_LEN + count * FONTSTORE_FONT_LEN) > size) {
+    return -1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const uint8_t *f       = base + FONTSTORE_HDR_LEN + i * FONTSTORE_FONT_LEN;
+    fontstore_font_t *font = &store->fonts[i];
+
+    font->size        = f[0];
+    font->line_height = f[1];
+    font->base_line   = (int8_t)f[2];
+    font->count       = rd32(f + 4);
+
+    uint32_t index = rd32(f + 8);
+
+    if (index > size || font->count > (size - index) / FONTSTORE_GLYPH_LEN) {
+      return -1;
+    }
+
+    font->index = base + index;
+  }
+
+  store->base  = base;
+  store->size  = size;
+  store->count = count;
+
+  return 0;
+}
+
+const fontstore_font_t *fontstore_font(const fontstore_t *store, int size) {
+  const fontstore_font_t *best = NULL;
+
+  // exact size if present, otherwise the closest one
+  for (int i = 0; i < store->count; i++) {
+    const fontstore_font_t *f = &store->fonts[i];
+
+    if (!best || abs(f->size - size) < abs(best->size - size)) {
+      best = f;
+    }
+  }
+
+  return best;
+}
+
+bool fontstore_find(const fontstore_t *store, const fontstore_font_t *font, uint32_t cp, fontstore_glyph_t *glyph) {
+  uint32_t lo = 0, hi = font->count;
+
+  while (lo < hi) {
+    uint32_t mid     = lo + (hi - lo) / 2;
+    const uint8_t *g = font->index + mid * FONTSTORE_GLYPH_LEN;
+    uint32_t c       = rd32(g);
+
+    if (c < cp) {
+      lo = mid + 1;
+    } else if (c > cp) {
+      hi = mid;
+    } else {
+      uint32_t offset = rd32(g + 4);
+      uint16_t len    = rd16(g + 8);
+
+      if (offset > store->size || len > store->size - offset) {
+        return false;
+      }
+
+      glyph->cp    = cp;
+      glyph->data  = store->base + offset;
+      glyph->len   = len;
+      glyph->box_w = g[10];
+      glyph->box_h = g[11];
+      glyph->ofs_x = (int8_t)g[12];
+      glyph->ofs_y = (int8_t)g[13];
+      glyph->adv_w = g[14];
+
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,31 @@
+// libFuzzer entry point for dns_reply(), which answers any UDP datagram sent to the captive portal's port 53
+#include <stdlib.h>
+#include <string.h>
+
+#include "damppi_core.h"
+
+// the portal's receive and send buffers
+#define DNS_BUF_LEN 512
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static const uint8_t ip[4] = { 192, 168, 4, 1 };
+
+  if (size > DNS_BUF_LEN) {
+    return 0;
+  }
+
+  uint8_t *rx = malloc(size ? size : 1);
+  uint8_t *tx = malloc(DNS_BUF_LEN);
+
+  memcpy(rx, data, size);
+
+  int len = dns_reply(rx, size, tx, DNS_BUF_LEN, ip);
+
+  if (len != -1 && (len != (int)size + 16 || memcmp(tx + 12, rx + 12, size - 12))) {
+    abort();
+  }
+
+  free(rx);
+  free(tx);
+  return 0;
+}
@@ -0,0 +1,42 @@
+// libFuzzer entry point for the font partition parser: opens the image, looks up glyphs and decodes them like
+// font.c does. The input is a corrupted partition, so the magic and version are put in front of it to get past
+// the header check.
+#include <stdlib.h>
+#include <string.h>
+
+#include "damppi_core.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static const uint8_t hdr[6] = { 'D', 'M', 'P', 'F', FONTSTORE_VERSION, 0 };
+
+  uint8_t *img = malloc(sizeof(hdr) + size);
+  memcpy(img, hdr, sizeof(hdr));
+  memcpy(img + sizeof(hdr), data, size);
+
+  fontstore_t store;
+
+  if (fontstore_open(&store, img, sizeof(hdr) + size) == 0) {
+    static uint8_t out[GLYPH_CACHE_SLOT_LEN];
+
+    for (int i = 0; i < store.count; i++) {
+      const fontstore_font_t *font = fontstore_font(&store, store.fonts[i].size);
+      fontstore_glyph_t glyph;
+
+      // every codepoint in the index, and the ones in between
+      for (uint32_t n = 0; n < font->count && n < 64; n++) {
+        const uint8_t *g = font->index + n * FONTSTORE_GLYPH_LEN;
+        uint32_t cp      = g[0] | g[1] << 8 | g[2] << 16 | (uint32_t)g[3] << 24;
+
+        for (uint32_t c = cp; c <= cp + 1 && c >= cp; c++) {
+          // font.c only decodes glyphs that fit a cache slot
+          if (fontstore_find(&store, font, c, &glyph) && glyph.box_w * glyph.box_h <= GLYPH_CACHE_SLOT_LEN) {
+            glyph_rle_decode(glyph.data, glyph.len, out, glyph.box_w, glyph.box_h, glyph.box_w);
+          }
+        }
+      }
+    }
+  }
+
+  free(img);
+  return 0;
+}
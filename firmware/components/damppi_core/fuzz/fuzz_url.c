@@ -0,0 +1,23 @@
+// libFuzzer entry point for url_decode_inplace(), which decodes form fields straight from HTTP requests
+#include <stdlib.h>
+#include <string.h>
+
+#include "damppi_core.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  char *s = malloc(size + 1);
+
+  memcpy(s, data, size);
+  s[size] = '\0';
+
+  size_t before = strlen(s);
+  url_decode_inplace(s);
+
+  // decoding only ever shrinks the string
+  if (strlen(s) > before) {
+    abort();
+  }
+
+  free(s);
+  return 0;
+}
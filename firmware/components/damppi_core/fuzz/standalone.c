@@ -0,0 +1,92 @@
+// Runs a libFuzzer entry point without libFuzzer, for compilers that lack -fsanitize=fuzzer: replays the files
+// given on the command line, then feeds -runs=N random inputs of up to -max_len=N bytes (defaults 10000 and 512).
+//   fuzz_dns [-runs=N] [-max_len=N] [-seed=N] [file...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "damppi_core.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint32_t rand_state;
+
+static uint32_t next(void) {
+  // xorshift32
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static void run_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *data = malloc(size ? size : 1);
+
+  if (fread(data, 1, size, f) != (size_t)size) {
+    perror(path);
+    exit(1);
+  }
+
+  fclose(f);
+  LLVMFuzzerTestOneInput(data, size);
+  free(data);
+}
+
+int main(int argc, char **argv) {
+  long runs = -1, max_len = 512;
+  int files  = 0;
+  rand_state = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "-runs=", 6)) {
+      runs = atol(argv[i] + 6);
+    } else if (!strncmp(argv[i], "-max_len=", 9)) {
+      max_len = atol(argv[i] + 9);
+    } else if (!strncmp(argv[i], "-seed=", 6)) {
+      rand_state = strtoul(argv[i] + 6, NULL, 0) | 1;
+    } else {
+      run_file(argv[i]);
+      files++;
+    }
+  }
+
+  // like libFuzzer, inputs given as files are only replayed
+  if (runs < 0) {
+    runs = files ? 0 : 10000;
+  }
+
+  uint8_t *data = malloc(max_len ? max_len : 1);
+
+  for (long n = 0; n < runs; n++) {
+    size_t size = next() % (max_len + 1);
+
+    // a small alphabet now and then, so escapes, name labels and runs line up more often than with random bytes
+    uint32_t mask = n % 2 ? 0xFF : 0x3F;
+
+    for (size_t i = 0; i < size; i++) {
+      data[i] = next() & mask;
+
+      if (n % 4 == 1 && next() % 8 == 0) {
+        data[i] = "%+0aF\0\x01\x10"[next() % 8];
+      }
+    }
+
+    LLVMFuzzerTestOneInput(data, size);
+  }
+
+  free(data);
+  printf("%ld runs\n", runs);
+  return 0;
+}
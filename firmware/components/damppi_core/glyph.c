@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "damppi_core.h"
+
+bool glyph_rle_decode(const uint8_t *in, int len, uint8_t *out, int w, int h, int stride) {
+  int x = 0, y = 0;
+
+  for (int i = 0; i < len; i++) {
+    uint8_t v = (in[i] >> 4) * 0x11;  // A4 to A8
+    int run   = (in[i] & 0x0F) + 1;
+
+    while (run--) {
+      if (y >= h) {
+        return false;
+      }
+
+      out[y * stride + x] = v;
+
+      if (++x == w) {
+        x = 0;
+        y++;
+      }
+    }
+  }
+
+  return y == h && x == 0;
+}
+
+const uint8_t *glyph_cache_get(glyph_cache_t *cache, uint32_t key) {
+  for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+    glyph_slot_t *slot = &cache->slots[i];
+
+    if (slot->key == key) {
+      slot->used = ++cache->tick;
+      cache->hits++;
+      return slot->data;
+    }
+  }
+
+  cache->misses++;
+  return NULL;
+}
+
+uint8_t *glyph_cache_put(glyph_cache_t *cache, uint32_t key, int len) {
+  if (len > GLYPH_CACHE_SLOT_LEN) {
+    return NULL;
+  }
+
+  glyph_slot_t *lru = &cache->slots[0];
+
+  for (int i = 1; i < GLYPH_CACHE_SLOTS && lru->key; i++) {
+    if (!cache->slots[i].key || cache->slots[i].used < lru->used) {
+      lru = &cache->slots[i];
+    }
+  }
+
+  if (lru->key) {
+    cache->evictions++;
+  }
+
+  lru->key  = key;
+  lru->used = ++cache->tick;
+
+  return lru->data;
+}
+
+void glyph_cache_drop(glyph_cache_t *cache, uint32_t key) {
+  for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+    if (cache->slots[i].key == key) {
+      cache->slots[i].key = 0;
+    }
+  }
+}
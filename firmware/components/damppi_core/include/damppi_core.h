@@ -0,0 +1,324 @@
+#ifndef DAMPPI_CORE_H
+#define DAMPPI_CORE_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// url.c
+int hexval(char c);
+void url_decode_inplace(char *s);
+
+// dns.c
+// builds an A record reply pointing every query at ip; returns the reply length or -1 if the query is unusable
+int dns_reply(const uint8_t *rx, int len, uint8_t *tx, int cap, const uint8_t ip[4]);
+
+// msg.c
+// vsnprintf that never cuts a UTF-8 sequence in half; returns true if the output was truncated
+bool msg_vformat(char *buf, int size, const char *fmt, va_list ap);
+bool msg_format(char *buf, int size, const char *fmt, ...);
+// escapes in for use inside a JSON string, truncating to fit size at a UTF-8 boundary; returns the output length
+int json_escape(char *out, int size, const char *in);
+
+// fontstore.c
+// glyph store image written to the font partition by tools/mkfont.py, little endian:
+//   header: magic[4] | version[2] | font_count[2]
+//   font:   size[1] | line_height[1] | base_line[1] | bpp[1] | glyph_count[4] | index_offset[4]
+//   glyph:  codepoint[4] | data_offset[4] | data_len[2] | box_w[1] | box_h[1] | ofs_x[1] | ofs_y[1] | adv_w[1] | pad[1]
+// glyph indexes are sorted by codepoint and glyph data is A4 RLE, see glyph_rle_decode()
+#define FONTSTORE_MAGIC "DMPF"
+#define FONTSTORE_VERSION 1
+#define FONTSTORE_HDR_LEN 8
+#define FONTSTORE_FONT_LEN 12
+#define FONTSTORE_GLYPH_LEN 16
+#define FONTSTORE_MAX_FONTS 4
+
+typedef struct {
+  uint8_t size;
+  uint8_t line_height;
+  int8_t base_line;
+  uint32_t count;
+  const uint8_t *index;
+} fontstore_font_t;
+
+typedef struct {
+  const uint8_t *base;
+  uint32_t size;
+  int count;
+  fontstore_font_t fonts[FONTSTORE_MAX_FONTS];
+} fontstore_t;
+
+typedef struct {
+  uint32_t cp;
+  const uint8_t *data;
+  uint16_t len;
+  uint8_t box_w;
+  uint8_t box_h;
+  int8_t ofs_x;
+  int8_t ofs_y;
+  uint8_t adv_w;
+} fontstore_glyph_t;
+
+// validates the image at base; returns 0 on success
+int fontstore_open(fontstore_t *store, const uint8_t *base, uint32_t size);
+const fontstore_font_t *fontstore_font(const fontstore_t *store, int size);
+bool fontstore_find(const fontstore_t *store, const fontstore_font_t *font, uint32_t cp, fontstore_glyph_t *glyph);
+
+// glyph.c
+// each RLE byte is value[4 bits] | run_length - 1[4 bits], rows left to right, top to bottom; decodes to A8
+bool glyph_rle_decode(const uint8_t *in, int len, uint8_t *out, int w, int h, int stride);
+
+#define GLYPH_CACHE_SLOTS 24
+#define GLYPH_CACHE_SLOT_LEN (32 * 32)
+
+typedef struct {
+  uint32_t key;  // 0 marks a free slot
+  uint32_t used;
+  uint8_t data[GLYPH_CACHE_SLOT_LEN];
+} glyph_slot_t;
+
+// fixed size LRU cache of decoded glyph bitmaps
+typedef struct {
+  glyph_slot_t slots[GLYPH_CACHE_SLOTS];
+  uint32_t tick;
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+} glyph_cache_t;
+
+const uint8_t *glyph_cache_get(glyph_cache_t *cache, uint32_t key);
+// returns the slot to decode into, evicting the least recently used one, or NULL if len does not fit a slot
+uint8_t *glyph_cache_put(glyph_cache_t *cache, uint32_t key, int len);
+void glyph_cache_drop(glyph_cache_t *cache, uint32_t key);
+
+// roam.c
+#define ROAM_HYSTERESIS_DB 8
+
+typedef struct {
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;
+} roam_ap_t;
+
+// strongest AP broadcasting one of the saved SSIDs, skipping the avoid BSSID if given; -1 if none is in range
+int roam_pick(const roam_ap_t *aps, int count, const char *const *saved, int nsaved, const uint8_t *avoid);
+
+// ratelimit.c
+// token bucket holding up to burst tokens, refilled by one every refill_ms
+typedef struct {
+  int burst;
+  int refill_ms;
+  int tokens;
+  int64_t last;
+} bucket_t;
+
+// takes a token at now (us); false if the bucket is empty
+bool bucket_take(bucket_t *b, int64_t now);
+
+#define COALESCE_SENDERS 16
+
+typedef struct {
+  uint64_t key;
+  int64_t time;
+} coalesce_entry_t;
+
+// remembers the last shown call of the most recent senders
+typedef struct {
+  int window_ms;
+  coalesce_entry_t entries[COALESCE_SENDERS];
+} coalesce_t;
+
+// true if a call from key at now (us) should be shown, false if it falls in the window of the previous one
+bool coalesce_check(coalesce_t *c, uint64_t key, int64_t now);
+
+// replay.c
+// replay protection for signed datagrams. A sender counts boot up from 1 on every boot and keeps it across power loss;
+// receivers accept each (boot, seq) once, within a sliding window behind the highest seq of the newest boot seen,
+// and never a boot older than that.
+#define REPLAY_SENDERS 32
+#define REPLAY_WINDOW 64
+#define REPLAY_RETIRED 128
+
+typedef struct {
+  uint8_t mac[6];
+  uint32_t boot;
+  uint32_t top;   // highest seq seen in boot
+  uint64_t bits;  // bit n set: top - n was seen
+  uint32_t used;  // 0 marks a free entry
+} replay_peer_t;
+
+// where a sender pushed out of the peer table had got to; when it comes back only newer datagrams are accepted
+typedef struct {
+  uint8_t mac[6];
+  uint32_t boot;
+  uint32_t top;
+} replay_retired_t;
+
+typedef struct {
+  replay_peer_t peers[REPLAY_SENDERS];
+  replay_retired_t retired[REPLAY_RETIRED];
+  uint32_t next_retired;
+  uint32_t tick;
+  uint32_t replayed;
+} replay_t;
+
+// true the first time a datagram (mac, boot, seq) is checked; false for a repeat, a seq too far behind, or a boot
+// older than the newest one seen from the sender. Only a sender pushed out of both tables starts over.
+bool replay_check(replay_t *r, const uint8_t mac[6], uint32_t boot, uint32_t seq);
+
+// backoff.c
+// reconnect delays doubling from base_ms up to max_ms, reset once a connection has stayed up for healthy_ms
+typedef struct {
+  int base_ms;
+  int max_ms;
+  int healthy_ms;
+  int attempt;
+  int delay_ms;
+  uint32_t rand;
+  int64_t up_since;
+  uint32_t attempts;
+  uint32_t connects;
+  uint32_t resets;
+} backoff_t;
+
+// seeds the jitter from the device MAC; salt tells apart several links of one device
+void backoff_seed(backoff_t *b, const uint8_t mac[6], uint8_t salt);
+
+// the link went down at now (us); returns how long to wait before the next attempt (ms)
+int backoff_next(backoff_t *b, int64_t now);
+
+// the link came up at now (us)
+void backoff_up(backoff_t *b, int64_t now);
+
+// bus.c
+// lock-free single-producer single-consumer ring of cap items of size bytes; cap must be a power of two.
+// The producer may be an ISR. Both sides fail instead of waiting when the ring is full or empty.
+typedef struct {
+  uint8_t *buf;
+  uint32_t size;
+  uint32_t cap;
+  uint32_t head;  // next to pop, written by the consumer
+  uint32_t tail;  // next to push, written by the producer
+} spsc_t;
+
+void spsc_init(spsc_t *r, void *buf, uint32_t size, uint32_t cap);
+bool spsc_push(spsc_t *r, const void *item);
+bool spsc_pop(spsc_t *r, void *item);
+
+// buffer size for an mpsc_t; every cell carries a sequence number in front of the item
+#define MPSC_STRIDE(size) (4 + (((size) + 3) & ~3u))
+#define MPSC_BUF_SIZE(size, cap) ((cap) * MPSC_STRIDE(size))
+
+// lock-free multi-producer single-consumer ring, same rules as spsc_t; buf must be 4-byte aligned
+typedef struct {
+  uint8_t *buf;
+  uint32_t size;
+  uint32_t cap;
+  uint32_t head;
+  uint32_t tail;
+} mpsc_t;
+
+void mpsc_init(mpsc_t *r, void *buf, uint32_t size, uint32_t cap);
+bool mpsc_push(mpsc_t *r, const void *item);
+bool mpsc_pop(mpsc_t *r, void *item);
+
+#define SNAP_SLOTS 4
+
+// buffer size for a snap_t; slots are 4-byte aligned
+#define SNAP_STRIDE(size) (((size) + 3) & ~3u)
+#define SNAP_BUF_SIZE(size) (SNAP_SLOTS * SNAP_STRIDE(size))
+
+// immutable snapshots of a state struct: a writer publishes a whole new copy into a free slot and readers
+// copy out the latest complete one, so they never see a half-written state. Neither side takes a lock;
+// a reader only retries when writers reused its slot during the copy. Up to SNAP_SLOTS - 2 writers may
+// publish at the same time. buf must be 4-byte aligned.
+typedef struct {
+  uint8_t *buf;
+  uint32_t size;
+  uint32_t gen[SNAP_SLOTS];  // 2n+2 once publish n is in the slot, odd while it is being written
+  uint32_t next;             // last claimed publish
+  uint32_t cur;              // latest complete publish * SNAP_SLOTS + its slot
+} snap_t;
+
+void snap_init(snap_t *s, void *buf, uint32_t size, const void *initial);
+void snap_publish(snap_t *s, const void *state);
+void snap_read(snap_t *s, void *out);
+
+// blog.c
+// binary log records: the addresses of the tag and format strings and the raw arguments, formatted later on a
+// host. A record is u16 size, u8 level, u8 truncated, u32 tag address, u32 format address, u32 time in ms, then
+// the arguments: 4 bytes for integers, 8 for 64-bit integers and doubles, u8 length and bytes for strings.
+#define BLOG_HDR_LEN 16
+#define BLOG_REC_MAX 96
+#define BLOG_STR_MAX 32
+
+typedef struct {
+  uint8_t buf[BLOG_REC_MAX];
+  uint32_t len;
+} blog_rec_t;
+
+void blog_rec_begin(blog_rec_t *r, uint8_t level, const char *tag, const char *fmt, uint32_t time_ms);
+void blog_put_u32(blog_rec_t *r, uint32_t v);
+void blog_put_u64(blog_rec_t *r, uint64_t v);
+void blog_put_f64(blog_rec_t *r, double v);
+void blog_put_str(blog_rec_t *r, const char *s);
+
+// byte ring of whole records that drops the oldest ones to make room; the caller serialises access
+typedef struct {
+  uint8_t *buf;
+  uint32_t cap;
+  uint32_t head;  // end of the newest record
+  uint32_t tail;  // start of the oldest record
+  uint32_t records;
+  uint32_t dropped;
+} blog_ring_t;
+
+void blog_ring_init(blog_ring_t *r, void *buf, uint32_t cap);
+void blog_ring_put(blog_ring_t *r, blog_rec_t *rec);
+
+// copies the records oldest first into out; returns the byte count, 0 if they do not fit in cap
+uint32_t blog_ring_copy(const blog_ring_t *r, uint8_t *out, uint32_t cap);
+
+// button timing, inlined into the GPIO ISR
+#define BTN_DEBOUNCE_MS 50
+#define BTN_MIN_GAP_MS 200
+#define BTN_DBL_CLK_MS 500
+
+#define BTN_NONE 0
+#define BTN_CLICK 1
+#define BTN_DBL_CLICK 2
+
+typedef struct {
+  int64_t last_isr_time;
+  int64_t last_click_time;
+} btn_state_t;
+
+// classifies a change of the pin at now (us) to level; released is level 1
+static inline int btn_event(btn_state_t *s, int64_t now, int level) {
+  if (now - s->last_isr_time < BTN_DEBOUNCE_MS * 1000) {
+    return BTN_NONE;
+  }
+
+  s->last_isr_time = now;
+
+  if (level) {
+    return BTN_NONE;
+  }
+
+  int64_t diff = now - s->last_click_time;
+
+  if (diff < BTN_DBL_CLK_MS * 1000) {
+    if (diff > BTN_MIN_GAP_MS * 1000) {
+      s->last_click_time = 0;
+      return BTN_DBL_CLICK;
+    }
+
+    return BTN_NONE;
+  }
+
+  s->last_click_time = now;
+  return BTN_CLICK;
+}
+
+#endif  // DAMPPI_CORE_H
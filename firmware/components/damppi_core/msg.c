@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "damppi_core.h"
+
+bool msg_vformat(char *buf, int size, const char *fmt, va_list ap) {
+  if (size <= 0) {
+    return true;
+  }
+
+  int len = vsnprintf(buf, size, fmt, ap);
+
+  if (len < 0) {
+    buf[0] = '\0';
+    return true;
+  }
+
+  if (len < size) {
+    return false;
+  }
+
+  // drop a trailing partial UTF-8 sequence so the label never shows a broken glyph
+  int end  = size - 1;
+  int lead = end;
+
+  while (lead > 0 && ((uint8_t)buf[lead - 1] & 0xC0) == 0x80) {
+    lead--;
+  }
+
+  if (lead > 0) {
+    uint8_t c = buf[lead - 1];
+    int need  = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+
+    if (end - (lead - 1) < need) {
+      end = lead - 1;
+    }
+  }
+
+  buf[end] = '\0';
+  return true;
+}
+
+bool msg_format(char *buf, int size, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  bool truncated = msg_vformat(buf, size, fmt, ap);
+  va_end(ap);
+
+  return truncated;
+}
+
+int json_escape(char *out, int size, const char *in) {
+  int o = 0;
+
+  for (const uint8_t *p = (const uint8_t *)in; *p && o < size - 1; p++) {
+    const char *esc = NULL;
+    char hex[7];
+
+    switch (*p) {
+      case '"':
+        esc = "\\\"";
+        break;
+      case '\\':
+        esc = "\\\\";
+        break;
+      case '\n':
+        esc = "\\n";
+        break;
+      default:
+        if (*p < 0x20) {
+          snprintf(hex, sizeof(hex), "\\u%04x", *p);
+          esc = hex;
+        }
+        break;
+    }
+
+    if (!esc) {
+      // a multibyte character goes in whole or not at all; its continuation bytes then always fit
+      int need = *p >= 0xF0 ? 4 : *p >= 0xE0 ? 3 : *p >= 0xC0 ? 2 : 1;
+
+      if (o + need > size - 1) {
+        break;
+      }
+
+      out[o++] = *p;
+      continue;
+    }
+
+    int len = strlen(esc);
+
+    if (o + len > size - 1) {
+      break;
+    }
+
+    memcpy(out + o, esc, len);
+    o += len;
+  }
+
+  out[o] = '\0';
+  return o;
+}
@@ -0,0 +1,55 @@
+#include "damppi_core.h"
+
+bool bucket_take(bucket_t *b, int64_t now) {
+  int64_t period = (int64_t)b->refill_ms * 1000;
+
+  if (!b->last) {
+    b->tokens = b->burst;
+    b->last   = now;
+  }
+
+  int64_t refill = (now - b->last) / period;
+
+  if (refill > 0) {
+    b->tokens = refill >= b->burst - b->tokens ? b->burst : b->tokens + refill;
+    b->last += refill * period;
+  }
+
+  // a full bucket does not bank time towards the next token
+  if (b->tokens == b->burst) {
+    b->last = now;
+  }
+
+  if (b->tokens <= 0) {
+    return false;
+  }
+
+  b->tokens--;
+  return true;
+}
+
+bool coalesce_check(coalesce_t *c, uint64_t key, int64_t now) {
+  coalesce_entry_t *oldest = &c->entries[0];
+
+  for (int i = 0; i < COALESCE_SENDERS; i++) {
+    coalesce_entry_t *e = &c->entries[i];
+
+    if (e->time && e->key == key) {
+      if (now - e->time < (int64_t)c->window_ms * 1000) {
+        return false;
+      }
+
+      e->time = now;
+      return true;
+    }
+
+    if (e->time < oldest->time) {
+      oldest = e;
+    }
+  }
+
+  oldest->key  = key;
+  oldest->time = now;
+
+  return true;
+}
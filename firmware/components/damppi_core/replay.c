@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "damppi_core.h"
+
+static replay_retired_t *replay_retired(replay_t *r, const uint8_t mac[6]) {
+  for (int i = 0; i < REPLAY_RETIRED; i++) {
+    replay_retired_t *e = &r->retired[i];
+
+    if (e->boot && !memcmp(e->mac, mac, sizeof(e->mac))) {
+      return e;
+    }
+  }
+
+  return NULL;
+}
+
+static void replay_retire(replay_t *r, const replay_peer_t *p) {
+  replay_retired_t *e = replay_retired(r, p->mac);
+
+  // the oldest retired sender goes first
+  if (!e) {
+    e = &r->retired[r->next_retired++ % REPLAY_RETIRED];
+  }
+
+  memcpy(e->mac, p->mac, sizeof(e->mac));
+  e->boot = p->boot;
+  e->top  = p->top;
+}
+
+static replay_peer_t *replay_peer(replay_t *r, const uint8_t mac[6]) {
+  replay_peer_t *oldest = &r->peers[0];
+
+  for (int i = 0; i < REPLAY_SENDERS; i++) {
+    replay_peer_t *p = &r->peers[i];
+
+    if (p->used && !memcmp(p->mac, mac, sizeof(p->mac))) {
+      return p;
+    }
+
+    if (p->used < oldest->used) {
+      oldest = p;
+    }
+  }
+
+  if (oldest->used) {
+    replay_retire(r, oldest);
+  }
+
+  memset(oldest, 0, sizeof(*oldest));
+  memcpy(oldest->mac, mac, sizeof(oldest->mac));
+
+  // a sender seen before resumes where it was, with everything up to its last seq counted as seen
+  const replay_retired_t *e = replay_retired(r, mac);
+
+  if (e) {
+    oldest->boot = e->boot;
+    oldest->top  = e->top;
+    oldest->bits = ~0ULL;
+    oldest->used = 1;
+  }
+
+  return oldest;
+}
+
+bool replay_check(replay_t *r, const uint8_t mac[6], uint32_t boot, uint32_t seq) {
+  replay_peer_t *p = replay_peer(r, mac);
+  bool fresh       = !p->used;
+
+  p->used = ++r->tick;
+
+  // an older boot can only be a capture; a newer one is the sender after a restart
+  if (!fresh && boot < p->boot) {
+    r->replayed++;
+    return false;
+  }
+
+  if (fresh || boot > p->boot) {
+    p->boot = boot;
+    p->top  = seq;
+    p->bits = 1;
+    return true;
+  }
+
+  // seq wraps, so compare by distance
+  int32_t ahead = (int32_t)(seq - p->top);
+
+  if (ahead > 0) {
+    p->bits = ahead >= REPLAY_WINDOW ? 1 : p->bits << ahead | 1;
+    p->top  = seq;
+    return true;
+  }
+
+  uint32_t behind = p->top - seq;
+
+  if (behind >= REPLAY_WINDOW || p->bits & 1ULL << behind) {
+    r->replayed++;
+    return false;
+  }
+
+  p->bits |= 1ULL << behind;
+  return true;
+}
@@ -0,0 +1,26 @@
+#include <string.h>
+
+#include "damppi_core.h"
+
+int roam_pick(const roam_ap_t *aps, int count, const char *const *saved, int nsaved, const uint8_t *avoid) {
+  int best = -1;
+
+  for (int i = 0; i < count; i++) {
+    if (avoid && !memcmp(aps[i].bssid, avoid, sizeof(aps[i].bssid))) {
+      continue;
+    }
+
+    if (best >= 0 && aps[i].rssi <= aps[best].rssi) {
+      continue;
+    }
+
+    for (int j = 0; j < nsaved; j++) {
+      if (saved[j][0] && !strcmp(aps[i].ssid, saved[j])) {
+        best = i;
+        break;
+      }
+    }
+  }
+
+  return best;
+}
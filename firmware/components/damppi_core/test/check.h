@@ -0,0 +1,22 @@
+// minimal assertions for the host tests: a failed CHECK is reported and the test keeps going
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <string.h>
+
+static int check_failures;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      check_failures++;                                                    \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_STR(a, b) CHECK(strcmp((a), (b)) == 0)
+
+#define CHECK_DONE() (check_failures ? (fprintf(stderr, "%d checks failed\n", check_failures), 1) : 0)
+
+#endif  // CHECK_H
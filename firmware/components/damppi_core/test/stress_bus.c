@@ -0,0 +1,216 @@
+// Hammers the lock-free rings and the state snapshot from several threads. Built with -fsanitize=thread, so a
+// missing barrier shows up as a reported race; the contents are checked for torn or lost items as well.
+//   stress_bus [iterations]
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "damppi_core.h"
+
+#define PRODUCERS 4
+#define RING_CAP 16
+
+// the iterations each producer and writer runs
+static long iters = 200000;
+
+typedef struct {
+  uint32_t producer;
+  uint32_t seq;
+  uint32_t check;
+} item_t;
+
+static spsc_t spsc;
+static uint8_t spsc_buf[RING_CAP * sizeof(item_t)];
+
+static mpsc_t mpsc;
+static uint32_t mpsc_buf[MPSC_BUF_SIZE(sizeof(item_t), RING_CAP) / 4];
+
+static item_t make_item(uint32_t producer, uint32_t seq) {
+  return (item_t){ .producer = producer, .seq = seq, .check = producer * 2654435761u ^ seq };
+}
+
+static void *spsc_producer(void *arg) {
+  (void)arg;
+
+  for (uint32_t seq = 0; seq < iters; seq++) {
+    item_t item = make_item(0, seq);
+
+    while (!spsc_push(&spsc, &item)) {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void *mpsc_producer(void *arg) {
+  uint32_t producer = (uintptr_t)arg;
+
+  for (uint32_t seq = 0; seq < iters; seq++) {
+    item_t item = make_item(producer, seq);
+
+    while (!mpsc_push(&mpsc, &item)) {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void test_spsc(void) {
+  pthread_t t;
+
+  spsc_init(&spsc, spsc_buf, sizeof(item_t), RING_CAP);
+  pthread_create(&t, NULL, spsc_producer, NULL);
+
+  for (uint32_t want = 0; want < iters;) {
+    item_t item;
+
+    if (!spsc_pop(&spsc, &item)) {
+      sched_yield();
+      continue;
+    }
+
+    CHECK(item.producer == 0 && item.seq == want && item.check == make_item(0, want).check);
+    want = item.seq + 1;
+  }
+
+  pthread_join(t, NULL);
+}
+
+static void test_mpsc(void) {
+  pthread_t t[PRODUCERS];
+  uint32_t next[PRODUCERS] = { 0 };
+
+  mpsc_init(&mpsc, mpsc_buf, sizeof(item_t), RING_CAP);
+
+  for (uintptr_t i = 0; i < PRODUCERS; i++) {
+    pthread_create(&t[i], NULL, mpsc_producer, (void *)i);
+  }
+
+  // every producer's items arrive once and in its own order
+  for (long left = PRODUCERS * iters; left > 0;) {
+    item_t item;
+
+    if (!mpsc_pop(&mpsc, &item)) {
+      sched_yield();
+      continue;
+    }
+
+    CHECK(item.producer < PRODUCERS);
+
+    if (item.producer < PRODUCERS) {
+      CHECK(item.seq == next[item.producer]);
+      CHECK(item.check == make_item(item.producer, item.seq).check);
+      next[item.producer] = item.seq + 1;
+    }
+
+    left--;
+  }
+
+  for (int i = 0; i < PRODUCERS; i++) {
+    pthread_join(t[i], NULL);
+  }
+
+  item_t extra;
+  CHECK(!mpsc_pop(&mpsc, &extra));
+}
+
+// as large as device_state_t, with every word carrying the same publish so a torn copy is obvious
+#define STATE_WORDS 56
+#define WRITERS (SNAP_SLOTS - 2)
+#define READERS 3
+
+typedef struct {
+  uint32_t writer;
+  uint32_t seq;
+  uint32_t words[STATE_WORDS];
+} state_t;
+
+static snap_t snap;
+static uint32_t snap_buf[SNAP_BUF_SIZE(sizeof(state_t)) / 4];
+static int writers_done;
+
+static void *snap_writer(void *arg) {
+  state_t state = { .writer = (uintptr_t)arg };
+
+  for (uint32_t seq = 1; seq <= iters; seq++) {
+    state.seq = seq;
+
+    for (int i = 0; i < STATE_WORDS; i++) {
+      state.words[i] = state.writer << 24 ^ seq;
+    }
+
+    snap_publish(&snap, &state);
+  }
+
+  __atomic_add_fetch(&writers_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void *snap_reader(void *arg) {
+  uint32_t last[WRITERS] = { 0 };
+  long *torn             = arg;
+
+  while (__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE) < WRITERS) {
+    state_t state;
+    snap_read(&snap, &state);
+
+    bool ok = state.writer < WRITERS && state.seq >= last[state.writer];
+
+    for (int i = 0; ok && i < STATE_WORDS; i++) {
+      ok = state.words[i] == (state.writer << 24 ^ state.seq);
+    }
+
+    // publishes of one writer never go backwards for a reader
+    if (!ok) {
+      (*torn)++;
+    } else {
+      last[state.writer] = state.seq;
+    }
+  }
+
+  return NULL;
+}
+
+static void test_snap(void) {
+  pthread_t w[WRITERS], r[READERS];
+  long torn[READERS] = { 0 };
+  state_t initial    = { 0 };
+
+  snap_init(&snap, snap_buf, sizeof(state_t), &initial);
+
+  for (uintptr_t i = 0; i < READERS; i++) {
+    pthread_create(&r[i], NULL, snap_reader, &torn[i]);
+  }
+
+  for (uintptr_t i = 0; i < WRITERS; i++) {
+    pthread_create(&w[i], NULL, snap_writer, (void *)i);
+  }
+
+  for (int i = 0; i < WRITERS; i++) {
+    pthread_join(w[i], NULL);
+  }
+
+  for (int i = 0; i < READERS; i++) {
+    pthread_join(r[i], NULL);
+    CHECK(torn[i] == 0);
+  }
+
+  state_t final;
+  snap_read(&snap, &final);
+  CHECK(final.seq == iters);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    iters = atol(argv[1]);
+  }
+
+  test_spsc();
+  test_mpsc();
+  test_snap();
+
+  return CHECK_DONE();
+}
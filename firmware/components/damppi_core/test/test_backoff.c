@@ -0,0 +1,54 @@
+#include "check.h"
+#include "damppi_core.h"
+
+#define MS 1000LL
+
+static const uint8_t mac[6] = { 0x40, 0x4c, 0xca, 0x12, 0x34, 0x56 };
+
+int main(void) {
+  backoff_t b = { .base_ms = 1000, .max_ms = 60000, .healthy_ms = 30000 };
+  backoff_seed(&b, mac, 0);
+
+  // delays stay under a cap doubling from base_ms up to max_ms
+  int64_t now = 0;
+
+  for (int i = 0; i < 20; i++) {
+    int64_t cap = 1000LL << i;
+    int delay   = backoff_next(&b, now);
+
+    CHECK(delay >= 0 && delay <= (cap < 60000 ? cap : 60000));
+    now += delay * MS;
+  }
+
+  CHECK(b.attempts == 20);
+
+  // a connection that drops quickly keeps backing off, a healthy one starts over
+  backoff_up(&b, now);
+  backoff_next(&b, now + 1000 * MS);
+  CHECK(b.resets == 0);
+  CHECK(b.attempt > 1);
+
+  backoff_up(&b, now);
+  CHECK(backoff_next(&b, now + 30000 * MS) <= 1000);
+  CHECK(b.resets == 1);
+  CHECK(b.connects == 2);
+
+  // the same MAC gives the same sequence, another link or device a different one
+  backoff_t x = { .base_ms = 1000, .max_ms = 60000 }, y = x, z = x;
+  backoff_seed(&x, mac, 1);
+  backoff_seed(&y, mac, 1);
+  backoff_seed(&z, mac, 2);
+
+  int same = 0, differ = 0;
+
+  for (int i = 0; i < 8; i++) {
+    int dx = backoff_next(&x, 0), dy = backoff_next(&y, 0), dz = backoff_next(&z, 0);
+    same += dx == dy;
+    differ += dx != dz;
+  }
+
+  CHECK(same == 8);
+  CHECK(differ > 0);
+
+  return CHECK_DONE();
+}
@@ -0,0 +1,27 @@
+#include "check.h"
+#include "damppi_core.h"
+
+#define MS 1000LL
+
+int main(void) {
+  btn_state_t s = { 0 };
+  int64_t t     = 1000 * MS;
+
+  CHECK(btn_event(&s, t, 0) == BTN_CLICK);
+  CHECK(btn_event(&s, t + 10 * MS, 1) == BTN_NONE);   // bounce
+  CHECK(btn_event(&s, t + 100 * MS, 1) == BTN_NONE);  // release
+
+  // second press inside the double click window but after the minimum gap
+  CHECK(btn_event(&s, t + 300 * MS, 0) == BTN_DBL_CLICK);
+
+  // a press right after a double click starts over
+  CHECK(btn_event(&s, t + 1000 * MS, 0) == BTN_CLICK);
+
+  // presses closer than the minimum gap are ignored
+  CHECK(btn_event(&s, t + 1150 * MS, 0) == BTN_NONE);
+
+  // one after the window is a new click
+  CHECK(btn_event(&s, t + 2000 * MS, 0) == BTN_CLICK);
+
+  return CHECK_DONE();
+}
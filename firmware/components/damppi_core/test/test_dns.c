@@ -0,0 +1,29 @@
+#include "check.h"
+#include "damppi_core.h"
+
+int main(void) {
+  static const uint8_t ip[4] = { 192, 168, 4, 1 };
+
+  // query for "a.io" A IN, id 0x1234
+  static const uint8_t query[] = { 0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    'a', 0x02, 'i', 'o', 0x00, 0x00, 0x01, 0x00, 0x01 };
+  uint8_t tx[512];
+
+  int len = dns_reply(query, sizeof(query), tx, sizeof(tx), ip);
+
+  CHECK(len == (int)sizeof(query) + 16);
+  CHECK(tx[0] == 0x12 && tx[1] == 0x34);
+  CHECK(tx[2] == 0x81 && tx[3] == 0x80);
+  CHECK(tx[6] == 0x00 && tx[7] == 0x01);
+  CHECK(tx[8] == 0 && tx[9] == 0 && tx[10] == 0 && tx[11] == 0);
+  CHECK(!memcmp(tx + 12, query + 12, sizeof(query) - 12));
+  CHECK(tx[sizeof(query)] == 0xC0 && tx[sizeof(query) + 1] == 0x0C);
+  CHECK(!memcmp(tx + len - 4, ip, 4));
+
+  // too short for a header, or no room for the answer
+  CHECK(dns_reply(query, 11, tx, sizeof(tx), ip) == -1);
+  CHECK(dns_reply(query, sizeof(query), tx, sizeof(query) + 15, ip) == -1);
+  CHECK(dns_reply(query, sizeof(query), tx, sizeof(query) + 16, ip) == (int)sizeof(query) + 16);
+
+  return CHECK_DONE();
+}
@@ -0,0 +1,73 @@
+#include "check.h"
+#include "damppi_core.h"
+
+static void wr16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+  wr16(p, v);
+  wr16(p + 2, v >> 16);
+}
+
+int main(void) {
+  // one 24 px font with glyphs for U+AC00 and U+AC01, each 2x2 pixels of one RLE byte
+  static const uint32_t cps[] = { 0xAC00, 0xAC01 };
+  enum { INDEX = FONTSTORE_HDR_LEN + FONTSTORE_FONT_LEN, DATA = INDEX + 2 * FONTSTORE_GLYPH_LEN, SIZE = DATA + 2 };
+  uint8_t img[SIZE] = { 0 };
+
+  memcpy(img, FONTSTORE_MAGIC, 4);
+  wr16(img + 4, FONTSTORE_VERSION);
+  wr16(img + 6, 1);
+
+  uint8_t *f = img + FONTSTORE_HDR_LEN;
+  f[0]       = 24;
+  f[1]       = 28;
+  f[2]       = (uint8_t)-5;
+  wr32(f + 4, 2);
+  wr32(f + 8, INDEX);
+
+  for (int i = 0; i < 2; i++) {
+    uint8_t *g = img + INDEX + i * FONTSTORE_GLYPH_LEN;
+    wr32(g, cps[i]);
+    wr32(g + 4, DATA + i);
+    wr16(g + 8, 1);
+    g[10]         = 2;
+    g[11]         = 2;
+    g[14]         = 3;
+    img[DATA + i] = (i ? 0xF0 : 0x80) | 3;
+  }
+
+  fontstore_t store;
+  fontstore_glyph_t glyph;
+
+  CHECK(fontstore_open(&store, img, SIZE) == 0);
+  CHECK(store.count == 1);
+
+  const fontstore_font_t *font = fontstore_font(&store, 30);
+  CHECK(font && font->size == 24 && font->line_height == 28 && font->base_line == -5);
+
+  CHECK(fontstore_find(&store, font, 0xAC01, &glyph));
+  CHECK(glyph.len == 1 && glyph.data == img + DATA + 1 && glyph.box_w == 2 && glyph.adv_w == 3);
+
+  uint8_t a8[4];
+  CHECK(glyph_rle_decode(glyph.data, glyph.len, a8, glyph.box_w, glyph.box_h, glyph.box_w));
+  CHECK(a8[0] == 0xFF && a8[3] == 0xFF);
+
+  CHECK(fontstore_find(&store, font, 0xAC00, &glyph));
+  CHECK(!fontstore_find(&store, font, 0xABFF, &glyph));
+  CHECK(!fontstore_find(&store, font, 0xAC02, &glyph));
+
+  // glyph data past the end of the image
+  wr32(img + INDEX + 4, SIZE);
+  CHECK(!fontstore_find(&store, font, 0xAC00, &glyph));
+
+  // an index that runs past the end, a bad version, a truncated header
+  CHECK(fontstore_open(&store, img, SIZE - 3) != 0);
+  CHECK(fontstore_open(&store, img, FONTSTORE_HDR_LEN - 1) != 0);
+  wr16(img + 4, FONTSTORE_VERSION + 1);
+  CHECK(fontstore_open(&store, img, SIZE) != 0);
+
+  return CHECK_DONE();
+}
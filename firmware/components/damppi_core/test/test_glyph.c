@@ -0,0 +1,82 @@
+#include "check.h"
+#include "damppi_core.h"
+
+// the encoder from tools/mkfont.py: runs of up to 16 equal A4 values
+static int rle_encode(const uint8_t *a8, int n, uint8_t *out) {
+  int len = 0;
+
+  for (int i = 0; i < n;) {
+    uint8_t v = a8[i] >> 4;
+    int run   = 1;
+
+    while (i + run < n && run < 16 && a8[i + run] >> 4 == v) {
+      run++;
+    }
+
+    out[len++] = v << 4 | (run - 1);
+    i += run;
+  }
+
+  return len;
+}
+
+int main(void) {
+  enum { W = 7, H = 5, STRIDE = 8 };
+  uint8_t src[W * H], rle[W * H], out[H * STRIDE];
+
+  // runs of different lengths, some across row ends, and single pixels
+  for (int i = 0; i < W * H; i++) {
+    src[i] = (i / 3 % 2 ? 0xF : i % 5) * 0x11;
+  }
+
+  int len = rle_encode(src, W * H, rle);
+
+  memset(out, 0xAA, sizeof(out));
+  CHECK(glyph_rle_decode(rle, len, out, W, H, STRIDE));
+
+  int same = 1;
+
+  for (int y = 0; y < H; y++) {
+    same &= !memcmp(out + y * STRIDE, src + y * W, W);
+    same &= out[y * STRIDE + W] == 0xAA;  // padding is left alone
+  }
+
+  CHECK(same);
+
+  // data that is too short, too long, or ends mid row is refused
+  CHECK(!glyph_rle_decode(rle, len - 1, out, W, H, STRIDE));
+  uint8_t longer[sizeof(rle) + 1];
+  memcpy(longer, rle, len);
+  longer[len] = 0x00;
+  CHECK(!glyph_rle_decode(longer, len + 1, out, W, H, STRIDE));
+  uint8_t one = 0xF3;
+  CHECK(!glyph_rle_decode(&one, 1, out, W, H, STRIDE));
+
+  static glyph_cache_t cache;
+
+  CHECK(glyph_cache_get(&cache, 1) == NULL);
+  CHECK(glyph_cache_put(&cache, 1, GLYPH_CACHE_SLOT_LEN + 1) == NULL);
+
+  for (uint32_t k = 1; k <= GLYPH_CACHE_SLOTS; k++) {
+    uint8_t *slot = glyph_cache_put(&cache, k, 16);
+    CHECK(slot != NULL);
+    slot[0] = k;
+  }
+
+  CHECK(cache.evictions == 0);
+
+  // touching key 1 makes key 2 the least recently used
+  const uint8_t *hit = glyph_cache_get(&cache, 1);
+  CHECK(hit && hit[0] == 1);
+  glyph_cache_put(&cache, 100, 16);
+  CHECK(cache.evictions == 1);
+  CHECK(glyph_cache_get(&cache, 2) == NULL);
+  CHECK(glyph_cache_get(&cache, 1) != NULL);
+
+  glyph_cache_drop(&cache, 1);
+  CHECK(glyph_cache_get(&cache, 1) == NULL);
+  CHECK(cache.hits == 2);
+  CHECK(cache.misses == 3);
+
+  return CHECK_DONE();
+}
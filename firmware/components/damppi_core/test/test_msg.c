@@ -0,0 +1,43 @@
+#include "check.h"
+#include "damppi_core.h"
+
+int main(void) {
+  char buf[16];
+
+  CHECK(!msg_format(buf, sizeof(buf), "%s %d", "call", 7));
+  CHECK_STR(buf, "call 7");
+
+  CHECK(msg_format(buf, 6, "%s", "truncated"));
+  CHECK_STR(buf, "trunc");
+
+  // "가나" is two 3-byte sequences; a cut inside the second one drops it whole
+  CHECK(msg_format(buf, 6, "%s", "\xea\xb0\x80\xeb\x82\x98"));
+  CHECK_STR(buf, "\xea\xb0\x80");
+  CHECK(!msg_format(buf, 7, "%s", "\xea\xb0\x80\xeb\x82\x98"));
+  CHECK_STR(buf, "\xea\xb0\x80\xeb\x82\x98");
+  CHECK(msg_format(buf, 3, "%s", "\xea\xb0\x80"));
+  CHECK_STR(buf, "");
+
+  // exactly fitting output is not truncated
+  CHECK(!msg_format(buf, 4, "%s", "abc"));
+  CHECK(msg_format(buf, 0, "%s", "abc"));
+
+  char out[32];
+
+  CHECK(json_escape(out, sizeof(out), "a\"b\\c\nd") == 10);
+  CHECK_STR(out, "a\\\"b\\\\c\\nd");
+  CHECK(json_escape(out, sizeof(out), "\x01") == 6);
+  CHECK_STR(out, "\\u0001");
+
+  // an escape that does not fit is left out whole
+  CHECK(json_escape(out, 4, "ab\"") == 2);
+  CHECK_STR(out, "ab");
+
+  // and so is a character that does not fit
+  CHECK(json_escape(out, 4, "a\xed\x95\x9c") == 1);
+  CHECK_STR(out, "a");
+  CHECK(json_escape(out, 5, "a\xed\x95\x9c") == 4);
+  CHECK_STR(out, "a\xed\x95\x9c");
+
+  return CHECK_DONE();
+}
@@ -0,0 +1,45 @@
+#include "check.h"
+#include "damppi_core.h"
+
+#define S (1000 * 1000LL)
+
+int main(void) {
+  bucket_t b = { .burst = 3, .refill_ms = 1000 };
+  int64_t t  = 100 * S;
+
+  CHECK(bucket_take(&b, t));
+  CHECK(bucket_take(&b, t));
+  CHECK(bucket_take(&b, t));
+  CHECK(!bucket_take(&b, t));
+  CHECK(!bucket_take(&b, t + S - 1));
+  CHECK(bucket_take(&b, t + S));
+  CHECK(!bucket_take(&b, t + S));
+
+  // a long pause refills to the burst and no further
+  t += 100 * S;
+  CHECK(bucket_take(&b, t));
+  CHECK(bucket_take(&b, t));
+  CHECK(bucket_take(&b, t));
+  CHECK(!bucket_take(&b, t));
+
+  coalesce_t c = { .window_ms = 5000 };
+
+  CHECK(coalesce_check(&c, 1, 10 * S));
+  CHECK(!coalesce_check(&c, 1, 11 * S));
+  CHECK(coalesce_check(&c, 2, 11 * S));
+  CHECK(coalesce_check(&c, 1, 15 * S));
+  CHECK(!coalesce_check(&c, 1, 19 * S));
+
+  // more senders than entries push the oldest one out, which is shown again inside its window
+  coalesce_t busy = { .window_ms = 5000 };
+
+  CHECK(coalesce_check(&busy, 1, 10 * S));
+
+  for (uint64_t k = 100; k < 100 + COALESCE_SENDERS; k++) {
+    CHECK(coalesce_check(&busy, k, 10 * S + (int64_t)k));
+  }
+
+  CHECK(coalesce_check(&busy, 1, 11 * S));
+
+  return CHECK_DONE();
+}
@@ -0,0 +1,54 @@
+#include "check.h"
+#include "damppi_core.h"
+
+int main(void) {
+  static replay_t r;
+  static const uint8_t a[6] = { 1, 2, 3, 4, 5, 6 }, b[6] = { 1, 2, 3, 4, 5, 7 };
+
+  CHECK(replay_check(&r, a, 7, 100));
+  CHECK(!replay_check(&r, a, 7, 100));
+  CHECK(replay_check(&r, b, 7, 100));
+
+  // out of order within the window once, never twice
+  CHECK(replay_check(&r, a, 7, 103));
+  CHECK(replay_check(&r, a, 7, 101));
+  CHECK(!replay_check(&r, a, 7, 101));
+  CHECK(!replay_check(&r, a, 7, 103));
+  CHECK(!replay_check(&r, a, 7, 103 - REPLAY_WINDOW));
+
+  // seq wraps around
+  CHECK(replay_check(&r, b, 9, 0xFFFFFFFF));
+  CHECK(replay_check(&r, b, 9, 0));
+  CHECK(!replay_check(&r, b, 9, 0xFFFFFFFF));
+
+  // a reboot counts boot up; the old boot is refused from then on
+  CHECK(replay_check(&r, a, 8, 5));
+  CHECK(!replay_check(&r, a, 7, 200));
+  CHECK(replay_check(&r, a, 8, 6));
+  CHECK(r.replayed == 6);
+
+  // a datagram captured five reboots ago is refused and does not silence the sender
+  for (uint32_t boot = 9; boot <= 13; boot++) {
+    CHECK(replay_check(&r, a, boot, 1));
+  }
+
+  CHECK(!replay_check(&r, a, 8, 7));
+  CHECK(replay_check(&r, a, 13, 2));
+  CHECK(r.replayed == 7);
+
+  // a sender pushed out of the table by many others comes back where it was
+  uint8_t other[6] = { 9, 9, 9, 0, 0, 0 };
+
+  for (int i = 0; i < REPLAY_SENDERS; i++) {
+    other[5] = i;
+    CHECK(replay_check(&r, other, 1, 0));
+  }
+
+  CHECK(!replay_check(&r, a, 12, 50));
+  CHECK(!replay_check(&r, a, 13, 2));
+  CHECK(replay_check(&r, a, 13, 3));
+  CHECK(replay_check(&r, a, 14, 0));
+  CHECK(r.replayed == 9);
+
+  return CHECK_DONE();
+}
@@ -0,0 +1,33 @@
+#include "check.h"
+#include "damppi_core.h"
+
+static void decode(const char *in, const char *want) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s", in);
+  url_decode_inplace(buf);
+  CHECK_STR(buf, want);
+}
+
+int main(void) {
+  CHECK(hexval('0') == 0);
+  CHECK(hexval('9') == 9);
+  CHECK(hexval('a') == 10);
+  CHECK(hexval('F') == 15);
+  CHECK(hexval('g') == -1);
+  CHECK(hexval('\0') == -1);
+
+  decode("", "");
+  decode("plain", "plain");
+  decode("a+b", "a b");
+  decode("%41%62c", "Abc");
+  decode("%ea%b0%80", "\xea\xb0\x80");
+  decode("100%25", "100%");
+
+  // malformed escapes are kept as they are
+  decode("%zz", "%zz");
+  decode("%4", "%4");
+  decode("%", "%");
+  decode("a%2", "a%2");
+
+  return CHECK_DONE();
+}
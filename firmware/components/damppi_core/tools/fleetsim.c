@@ -0,0 +1,111 @@
+// Simulates a fleet of pagers reconnecting after a broker restart, with the fixed retry interval of esp-mqtt
+// against backoff.c, and prints the broker connection rate and the time until every pager is back as JSON.
+//   fleetsim [devices] [outage_s] [capacity_per_s]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "damppi_core.h"
+
+#define TICK_MS 10
+#define SIM_MS (30 * 60 * 1000)
+
+// esp-mqtt's default reconnect_timeout_ms
+#define FIXED_RETRY_MS 10000
+
+typedef struct {
+  bool up;
+  int64_t next_ms;
+  backoff_t backoff;
+} device_t;
+
+static int retry_delay(device_t *d, bool jitter, int64_t now_ms) {
+  return jitter ? backoff_next(&d->backoff, now_ms * 1000) : FIXED_RETRY_MS;
+}
+
+static void simulate(const char *policy, bool jitter, int devices, int outage_ms, int capacity) {
+  device_t *fleet = calloc(devices, sizeof(device_t));
+  int *rate       = calloc(SIM_MS / 1000, sizeof(int));
+
+  // the broker accepts up to capacity handshakes a second and refuses the rest
+  bucket_t broker = { .burst = capacity, .refill_ms = 1000 / capacity };
+
+  for (int i = 0; i < devices; i++) {
+    uint8_t mac[6] = { 0x40, 0x4c, 0xca, i >> 16, i >> 8, i };
+
+    fleet[i].backoff = (backoff_t){ .base_ms = 1000, .max_ms = 60000, .healthy_ms = 30000 };
+    backoff_seed(&fleet[i].backoff, mac, 1);  // salted like LINK_MQTT on the device
+
+    // every pager sees the broker go away at t=0
+    fleet[i].next_ms = retry_delay(&fleet[i], jitter, 0);
+  }
+
+  int up             = 0;
+  int64_t recovered  = -1;
+  uint32_t attempts  = 0;
+  int64_t total_wait = 0;
+
+  for (int64_t now = 0; now < SIM_MS && recovered < 0; now += TICK_MS) {
+    for (int i = 0; i < devices; i++) {
+      device_t *d = &fleet[i];
+
+      if (d->up || d->next_ms > now) {
+        continue;
+      }
+
+      attempts++;
+      rate[now / 1000]++;
+
+      if (now >= outage_ms && bucket_take(&broker, now * 1000)) {
+        d->up = true;
+        backoff_up(&d->backoff, now * 1000);
+        total_wait += now;
+        up++;
+      } else {
+        d->next_ms = now + retry_delay(d, jitter, now);
+      }
+    }
+
+    if (up == devices) {
+      recovered = now;
+    }
+  }
+
+  // attempts while the broker is down only hit a closed port; the load that matters is after it is back
+  int peak = 0;
+  int last = recovered < 0 ? SIM_MS / 1000 : recovered / 1000 + 1;
+
+  for (int s = outage_ms / 1000; s < last; s++) {
+    peak = rate[s] > peak ? rate[s] : peak;
+  }
+
+  printf("{\"policy\":\"%s\",\"devices\":%d,\"outage_ms\":%d,\"capacity_per_s\":%d,\"attempts\":%u,"
+         "\"peak_attempts_per_s_after_outage\":%d,\"recovery_ms\":%lld,\"mean_reconnect_ms\":%lld,\"attempts_per_s\":[",
+    policy, devices, outage_ms, capacity, attempts, peak, (long long)recovered,
+    (long long)(up ? total_wait / up : -1));
+
+  for (int s = 0; s < last; s++) {
+    printf(s ? ",%d" : "%d", rate[s]);
+  }
+
+  printf("]}\n");
+
+  free(rate);
+  free(fleet);
+}
+
+int main(int argc, char **argv) {
+  int devices  = argc > 1 ? atoi(argv[1]) : 500;
+  int outage_s = argc > 2 ? atoi(argv[2]) : 30;
+  int capacity = argc > 3 ? atoi(argv[3]) : 50;
+
+  if (devices <= 0 || outage_s < 0 || capacity <= 0 || capacity > 1000) {
+    fprintf(stderr, "usage: %s [devices] [outage_s] [capacity_per_s]\n", argv[0]);
+    return 1;
+  }
+
+  simulate("fixed", false, devices, outage_s * 1000, capacity);
+  simulate("backoff", true, devices, outage_s * 1000, capacity);
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include "damppi_core.h"
+
+int hexval(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+
+  if (c >= 'a' && c <= 'f') {
+    return 10 + (c - 'a');
+  }
+
+  if (c >= 'A' && c <= 'F') {
+    return 10 + (c - 'A');
+  }
+
+  return -1;
+}
+
+void url_decode_inplace(char *s) {
+  char *o = s;
+
+  for (char *p = s; *p; p++) {
+    if (*p == '+') {
+      *o++ = ' ';
+    } else if (*p == '%' && p[1] && p[2]) {
+      int a = hexval(p[1]), b = hexval(p[2]);
+
+      if (a >= 0 && b >= 0) {
+        *o++ = (char)((a << 4) | b);
+        p += 2;
+      } else {
+        *o++ = *p;
+      }
+    } else {
+      *o++ = *p;
+    }
+  }
+  *o = 0;
+}
@@ -0,0 +1,178 @@
+#include "esp_http_server.h"
+#include "esp_timer.h"
+
+#include "damppi_core.h"
+#include "main.h"
+
+#define API_QUEUE_LEN 4
+#define API_EVENT_LEN 160
+
+static const char *TAG = "API";
+
+static httpd_handle_t api_httpd = NULL;
+static QueueHandle_t api_queue  = NULL;
+
+// POST /api/call is answered from this task so a slow publish never holds the httpd task
+static void api_task(void *arg) {
+  httpd_req_t *req;
+
+  while (true) {
+    if (xQueueReceive(api_queue, &req, portMAX_DELAY)) {
+      bool sent = call_send();
+
+      httpd_resp_set_type(req, "application/json");
+
+      if (!sent) {
+        httpd_resp_set_status(req, "429 Too Many Requests");
+      }
+
+      httpd_resp_send(req, sent ? "{\"ok\":true}" : "{\"ok\":false}", HTTPD_RESP_USE_STRLEN);
+      httpd_req_async_handler_complete(req);
+    }
+  }
+}
+
+esp_err_t call_post(httpd_req_t *req) {
+  httpd_req_t *async = NULL;
+
+  if (httpd_req_async_handler_begin(req, &async) != ESP_OK) {
+    return httpd_resp_send_500(req);
+  }
+
+  // the original req belongs to the async copy from here on, so the answer goes through it before it is completed
+  if (!xQueueSend(api_queue, &async, 0)) {
+    httpd_resp_set_type(async, "application/json");
+    httpd_resp_set_status(async, "503 Service Unavailable");
+    esp_err_t err = httpd_resp_send(async, "{\"ok\":false}", HTTPD_RESP_USE_STRLEN);
+    httpd_req_async_handler_complete(async);
+    return err;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t stats_get(httpd_req_t *req) {
+  char out[1280];
+  reconnect_stats_t wifi, mqtt;
+
+  reconnect_stats(LINK_WIFI, &wifi);
+  reconnect_stats(LINK_MQTT, &mqtt);
+
+  uint32_t log_records, log_dropped;
+  blog_stats(&log_records, &log_dropped);
+
+  power_stats_t power;
+  power_stats(&power);
+
+  snprintf(out, sizeof(out),
+    "{\"call\":{\"sent\":%" PRIu32 ",\"limited\":%" PRIu32 ",\"received\":%" PRIu32 ",\"duplicates\":%" PRIu32
+    ",\"coalesced\":%" PRIu32 ",\"burst\":%d,\"refill_ms\":%d,\"coalesce_ms\":%d},"
+    "\"msgbuf\":{\"truncated\":%" PRIu32 ",\"exhausted\":%" PRIu32 "},"
+    "\"lcd\":{\"frames\":%" PRIu32 ",\"dropped\":%" PRIu32 ",\"render_max_us\":%lld,\"flush_max_us\":%lld},"
+    "\"font\":{\"lookups\":%" PRIu32 ",\"renders\":%" PRIu32 ",\"cache_hits\":%" PRIu32 ",\"cache_misses\":%" PRIu32 "},"
+    "\"tls\":{\"full\":{\"count\":%" PRIu32 ",\"last_us\":%lld,\"heap_peak\":%u},"
+    "\"resumed\":{\"count\":%" PRIu32 ",\"last_us\":%lld,\"heap_peak\":%u}},"
+    "\"reconnect\":{\"wifi\":{\"attempts\":%" PRIu32 ",\"connects\":%" PRIu32 ",\"resets\":%" PRIu32
+    ",\"delay_ms\":%d},"
+    "\"mqtt\":{\"attempts\":%" PRIu32 ",\"connects\":%" PRIu32 ",\"resets\":%" PRIu32 ",\"delay_ms\":%d}},"
+    "\"log\":{\"records\":%" PRIu32 ",\"dropped\":%" PRIu32 "},"
+    "\"power\":{\"mode\":\"%s\",\"uptime_ms\":%lld,\"sleeps\":%" PRIu32 ",\"sleep_ms\":%lld},"
+    "\"btn_latency_max_us\":%lld}",
+    call_stats.sent, call_stats.limited, call_stats.received, call_stats.duplicates, call_stats.coalesced,
+    CONFIG_DAMPPI_CALL_BURST, CONFIG_DAMPPI_CALL_REFILL_MS, CONFIG_DAMPPI_CALL_COALESCE_MS,
+    msgbuf_stats.truncated, msgbuf_stats.exhausted, lcd_stats.frames, lcd_stats.dropped, lcd_stats.render_max_us,
+    lcd_stats.flush_max_us, font_stats.lookups, font_stats.renders, font_stats.cache_hits, font_stats.cache_misses,
+    tls_stats.full.count, tls_stats.full.last_us, (unsigned)tls_stats.full.heap_peak, tls_stats.resumed.count,
+    tls_stats.resumed.last_us, (unsigned)tls_stats.resumed.heap_peak, wifi.attempts, wifi.connects,
+    wifi.resets, wifi.delay_ms, mqtt.attempts, mqtt.connects, mqtt.resets, mqtt.delay_ms, log_records, log_dropped,
+    power_mode, esp_timer_get_time() / 1000, power.sleeps, power.sleep_us / 1000, btn_latency_max_us);
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  return httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t ws_get(httpd_req_t *req) {
+  // the handshake; the socket is picked up by api_event from now on
+  if (req->method == HTTP_GET) {
+    ESP_LOGI(TAG, "websocket client %d connected", httpd_req_to_sockfd(req));
+    return ESP_OK;
+  }
+
+  // clients have nothing to say; read the header for the length first, then drain the payload whole
+  uint8_t buf[128];
+  httpd_ws_frame_t frame = { .payload = buf };
+
+  esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+
+  if (err != ESP_OK || !frame.len) {
+    return err;
+  }
+
+  // a partial read would leave the rest to be parsed as the next frame, so larger frames close the connection
+  if (frame.len > sizeof(buf)) {
+    ESP_LOGW(TAG, "websocket client %d sent a %zu byte frame, closing", httpd_req_to_sockfd(req), frame.len);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
+typedef struct {
+  int len;
+  char json[];
+} api_event_t;
+
+static void api_event_send(void *arg) {
+  api_event_t *ev = arg;
+  size_t count    = CONFIG_LWIP_MAX_SOCKETS;
+  int fds[CONFIG_LWIP_MAX_SOCKETS];
+
+  if (httpd_get_client_list(api_httpd, &count, fds) == ESP_OK) {
+    httpd_ws_frame_t frame = {
+      .final   = true,
+      .type    = HTTPD_WS_TYPE_TEXT,
+      .payload = (uint8_t *)ev->json,
+      .len     = ev->len,
+    };
+
+    for (int i = 0; i < count; i++) {
+      if (httpd_ws_get_fd_info(api_httpd, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+        httpd_ws_send_frame_async(api_httpd, fds[i], &frame);
+      }
+    }
+  }
+
+  free(ev);
+}
+
+// pushes {"type":type,"text":text} to every websocket client; safe to call from any task
+void api_event(const char *type, const char *text) {
+  if (!api_httpd) {
+    return;
+  }
+
+  api_event_t *ev = malloc(sizeof(api_event_t) + API_EVENT_LEN);
+
+  if (!ev) {
+    return;
+  }
+
+  char escaped[API_EVENT_LEN - 32];
+  json_escape(escaped, sizeof(escaped), text);
+
+  // both cuts land on a UTF-8 boundary, a browser drops a text frame that is not valid UTF-8
+  msg_format(ev->json, API_EVENT_LEN, "{\"type\":\"%s\",\"text\":\"%s\"}", type, escaped);
+  ev->len = strlen(ev->json);
+
+  if (httpd_queue_work(api_httpd, api_event_send, ev) != ESP_OK) {
+    free(ev);
+  }
+}
+
+void api_init(httpd_handle_t httpd) {
+  api_queue = xQueueCreate(API_QUEUE_LEN, sizeof(httpd_req_t *));
+  xTaskCreate(api_task, "api", 3072, NULL, 4, NULL);
+
+  api_httpd = httpd;
+}
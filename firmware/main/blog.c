@@ -0,0 +1,94 @@
+#include "esp_app_desc.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+
+#include "damppi_core.h"
+#include "main.h"
+
+#define BLOG_RING_SIZE (16 * 1024)
+
+// header of a /api/log download, followed by the records oldest first; see tools/blogdump.py
+typedef struct {
+  char magic[4];
+  uint8_t elf_sha256[32];
+  uint32_t records;
+  uint32_t dropped;
+} blog_file_t;
+
+static const char *TAG = "BLOG";
+
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static blog_ring_t ring;
+static uint8_t ring_buf[BLOG_RING_SIZE];
+
+void blog_init(void) {
+  blog_ring_init(&ring, ring_buf, sizeof(ring_buf));
+}
+
+void blog_begin(blog_rec_t *r, uint8_t level, const char *tag, const char *fmt) {
+  blog_rec_begin(r, level, tag, fmt, esp_timer_get_time() / 1000);
+}
+
+void blog_end(blog_rec_t *r) {
+  taskENTER_CRITICAL(&ring_lock);
+  blog_ring_put(&ring, r);
+  taskEXIT_CRITICAL(&ring_lock);
+}
+
+void blog_stats(uint32_t *records, uint32_t *dropped) {
+  taskENTER_CRITICAL(&ring_lock);
+  *records = ring.records;
+  *dropped = ring.dropped;
+  taskEXIT_CRITICAL(&ring_lock);
+}
+
+esp_err_t log_get(httpd_req_t *req) {
+  blog_file_t *file = malloc(sizeof(blog_file_t) + BLOG_RING_SIZE);
+
+  if (!file) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    return httpd_resp_send(req, NULL, 0);
+  }
+
+  memcpy(file->magic, "DLOG", 4);
+  memcpy(file->elf_sha256, esp_app_get_description()->app_elf_sha256, sizeof(file->elf_sha256));
+
+  // a plain copy of the ring, a few tens of microseconds at most
+  taskENTER_CRITICAL(&ring_lock);
+  uint32_t len  = blog_ring_copy(&ring, (uint8_t *)(file + 1), BLOG_RING_SIZE);
+  file->records = ring.records;
+  file->dropped = ring.dropped;
+  taskEXIT_CRITICAL(&ring_lock);
+
+  httpd_resp_set_type(req, "application/octet-stream");
+  httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"damppi.blog\"");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  esp_err_t err = httpd_resp_send(req, (const char *)file, sizeof(blog_file_t) + len);
+
+  free(file);
+  return err;
+}
+
+#if CONFIG_DAMPPI_BLOG_BENCH
+// one-off comparison of a log call against ESP_LOGI with the same arguments, printed at boot
+void blog_bench(void) {
+  const int n = 32;
+
+  int64_t start = esp_timer_get_time();
+
+  for (int i = 0; i < n; i++) {
+    BLOGI("bench %d %s %" PRIu32, i, "payload", (uint32_t)start);
+  }
+
+  int64_t blog_us = esp_timer_get_time() - start;
+  start           = esp_timer_get_time();
+
+  for (int i = 0; i < n; i++) {
+    ESP_LOGI(TAG, "bench %d %s %" PRIu32, i, "payload", (uint32_t)start);
+  }
+
+  int64_t logi_us = esp_timer_get_time() - start;
+
+  ESP_LOGI(TAG, "per call: BLOGI %lld ns, ESP_LOGI %lld ns", blog_us * 1000 / n, logi_us * 1000 / n);
+}
+#endif
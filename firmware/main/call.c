@@ -0,0 +1,146 @@
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "damppi_core.h"
+#include "main.h"
+
+#define CALL_DEDUP_LEN 16
+#define CALL_TIMEOUT_MS (60 * 1000)
+
+typedef struct {
+  call_id_t id;
+  call_path_t path;
+  int64_t time;
+} call_seen_t;
+
+static const char *TAG = "CALL";
+
+static const char *path_name[] = {
+  [CALL_MQTT] = "MQTT",
+  [CALL_LAN]  = "LAN",
+};
+
+static portMUX_TYPE seen_lock = portMUX_INITIALIZER_UNLOCKED;
+static call_seen_t seen[CALL_DEDUP_LEN];
+static int seen_next;
+
+static uint32_t next_seq;
+
+static portMUX_TYPE bucket_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bucket_t bucket = {
+  .burst     = CONFIG_DAMPPI_CALL_BURST,
+  .refill_ms = CONFIG_DAMPPI_CALL_REFILL_MS,
+};
+
+static coalesce_t coalesce = {
+  .window_ms = CONFIG_DAMPPI_CALL_COALESCE_MS,
+};
+
+call_stats_t call_stats;
+
+void call_init(void) {
+  next_seq = esp_random();
+}
+
+// returns false if the sender has used up its calls for now
+bool call_send(void) {
+  taskENTER_CRITICAL(&bucket_lock);
+  bool allowed = bucket_take(&bucket, esp_timer_get_time());
+  taskEXIT_CRITICAL(&bucket_lock);
+
+  if (!allowed) {
+    __atomic_fetch_add(&call_stats.limited, 1, __ATOMIC_RELAXED);
+    ESP_LOGW(TAG, "rate limited");
+    lcd_printf(LV_FONT(24), 3 * 1000, "Too many calls\nTry again later");
+    return false;
+  }
+
+  __atomic_fetch_add(&call_stats.sent, 1, __ATOMIC_RELAXED);
+
+  uint32_t seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+
+  mqtt_publish(seq);
+#if CONFIG_DAMPPI_LAN
+  lan_publish(seq);
+#endif
+
+  return true;
+}
+
+// senders are keyed by MAC; legacy calls without an id by a hash of the name
+static uint64_t call_sender(const call_id_t *id, const char *name) {
+  uint64_t key = 0;
+
+  if (id) {
+    for (int i = 0; i < sizeof(id->mac); i++) {
+      key = key << 8 | id->mac[i];
+    }
+
+    return key;
+  }
+
+  key = 0xcbf29ce484222325ULL;
+
+  for (const char *p = name; *p; p++) {
+    key = (key ^ (uint8_t)*p) * 0x100000001b3ULL;
+  }
+
+  return key | 1ULL << 63;
+}
+
+// returns the matching entry if this call was already delivered by another path
+static bool call_seen(const call_id_t *id, call_path_t path, int64_t now, call_seen_t *prev) {
+  bool found = false;
+
+  taskENTER_CRITICAL(&seen_lock);
+
+  for (int i = 0; i < CALL_DEDUP_LEN; i++) {
+    if (seen[i].time && seen[i].id.seq == id->seq && !memcmp(seen[i].id.mac, id->mac, sizeof(id->mac))) {
+      *prev = seen[i];
+      found = true;
+      break;
+    }
+  }
+
+  if (!found) {
+    seen[seen_next] = (call_seen_t){ .id = *id, .path = path, .time = now };
+    seen_next       = (seen_next + 1) % CALL_DEDUP_LEN;
+  }
+
+  taskEXIT_CRITICAL(&seen_lock);
+
+  return found;
+}
+
+// takes ownership of the pool buffer holding the name
+void call_recv(const call_id_t *id, call_path_t path, char *name) {
+  int64_t now = esp_timer_get_time();
+  call_seen_t prev;
+
+  // legacy senders publish without an id and cannot be deduplicated
+  if (id && call_seen(id, path, now, &prev)) {
+    BLOGI("duplicate via %s, %lld us after %s", path_name[path], now - prev.time, path_name[prev.path]);
+    __atomic_fetch_add(&call_stats.duplicates, 1, __ATOMIC_RELAXED);
+    msgbuf_put(name);
+    return;
+  }
+
+  taskENTER_CRITICAL(&seen_lock);
+  bool show = coalesce_check(&coalesce, call_sender(id, name), now);
+  taskEXIT_CRITICAL(&seen_lock);
+
+  // the previous call from this sender is still on screen; don't wake the display again
+  if (!show) {
+    BLOGI("coalesced call from %s", name);
+    __atomic_fetch_add(&call_stats.coalesced, 1, __ATOMIC_RELAXED);
+    msgbuf_put(name);
+    return;
+  }
+
+  __atomic_fetch_add(&call_stats.received, 1, __ATOMIC_RELAXED);
+
+  BLOGI("call via %s: %s", path_name[path], name);
+  api_event("call", name);
+  lcd_call(name, CALL_TIMEOUT_MS);
+}
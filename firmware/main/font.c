@@ -0,0 +1,148 @@
+#include "esp_partition.h"
+#include "esp_timer.h"
+
+#include "damppi_core.h"
+#include "main.h"
+
+#define FONT_PARTITION "font"
+
+static const char *TAG = "FONT";
+
+// Montserrat copies whose fallback resolves Hangul/CJK from the glyph store
+lv_font_t font_24;
+lv_font_t font_30;
+
+static lv_font_t store_24;
+static lv_font_t store_30;
+
+static fontstore_t store;
+static glyph_cache_t cache;
+
+font_stats_t font_stats;
+
+static bool store_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter, uint32_t next) {
+  const fontstore_font_t *f = font->dsc;
+  fontstore_glyph_t g;
+
+  int64_t start = esp_timer_get_time();
+  bool found    = fontstore_find(&store, f, letter, &g);
+  font_stats.lookups++;
+  font_stats.lookup_us += esp_timer_get_time() - start;
+
+  if (!found) {
+    return false;
+  }
+
+  dsc->adv_w     = g.adv_w;
+  dsc->box_w     = g.box_w;
+  dsc->box_h     = g.box_h;
+  dsc->ofs_x     = g.ofs_x;
+  dsc->ofs_y     = g.ofs_y;
+  dsc->format    = LV_FONT_GLYPH_FORMAT_A8;
+  dsc->gid.index = letter;
+
+  return true;
+}
+
+static const void *store_glyph_bitmap(lv_font_glyph_dsc_t *dsc, lv_draw_buf_t *draw_buf) {
+  const fontstore_font_t *f = dsc->resolved_font->dsc;
+  fontstore_glyph_t g;
+
+  if (!fontstore_find(&store, f, dsc->gid.index, &g) || !g.box_w || !g.box_h) {
+    return NULL;
+  }
+
+  int64_t start  = esp_timer_get_time();
+  uint32_t key   = (uint32_t)f->size << 24 | g.cp;
+  uint32_t len   = g.box_w * g.box_h;
+  uint32_t pitch = draw_buf->header.stride;
+  uint8_t *out   = draw_buf->data;
+  bool ok        = true;
+
+  const uint8_t *cached = glyph_cache_get(&cache, key);
+
+  if (!cached) {
+    uint8_t *slot = glyph_cache_put(&cache, key, len);
+
+    // glyphs too large for a cache slot are decoded straight into the draw buffer
+    if (slot) {
+      ok     = glyph_rle_decode(g.data, g.len, slot, g.box_w, g.box_h, g.box_w);
+      cached = slot;
+    } else {
+      ok = glyph_rle_decode(g.data, g.len, out, g.box_w, g.box_h, pitch);
+    }
+  }
+
+  if (ok && cached) {
+    for (int y = 0; y < g.box_h; y++) {
+      memcpy(out + y * pitch, cached + y * g.box_w, g.box_w);
+    }
+  }
+
+  font_stats.renders++;
+  font_stats.render_us += esp_timer_get_time() - start;
+  font_stats.cache_hits   = cache.hits;
+  font_stats.cache_misses = cache.misses;
+
+  if (!ok) {
+    glyph_cache_drop(&cache, key);
+    ESP_LOGW(TAG, "corrupt glyph U+%04" PRIX32, g.cp);
+    return NULL;
+  }
+
+  return draw_buf;
+}
+
+static void font_store_init(lv_font_t *font, int size) {
+  const fontstore_font_t *f = fontstore_font(&store, size);
+
+  *font                  = (lv_font_t){ 0 };
+  font->get_glyph_dsc    = store_glyph_dsc;
+  font->get_glyph_bitmap = store_glyph_bitmap;
+  font->line_height      = f->line_height;
+  font->base_line        = f->base_line;
+  font->dsc              = f;
+}
+
+void font_init(void) {
+  font_24 = lv_font_montserrat_24;
+  font_30 = lv_font_montserrat_30;
+
+  const esp_partition_t *part =
+    esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FONT_PARTITION);
+
+  if (!part) {
+    ESP_LOGW(TAG, "no %s partition", FONT_PARTITION);
+    return;
+  }
+
+  const void *base;
+  esp_partition_mmap_handle_t handle;
+
+  if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &base, &handle) != ESP_OK) {
+    ESP_LOGW(TAG, "mmap failed");
+    return;
+  }
+
+  if (fontstore_open(&store, base, part->size) != 0 || !store.count) {
+    ESP_LOGW(TAG, "no glyph store in %s partition", FONT_PARTITION);
+    esp_partition_munmap(handle);
+    return;
+  }
+
+  font_store_init(&store_24, 24);
+  font_store_init(&store_30, 30);
+
+  font_24.fallback = &store_24;
+  font_30.fallback = &store_30;
+
+  ESP_LOGI(TAG, "glyph store with %d fonts mapped", store.count);
+}
+
+void font_log_stats(void) {
+  if (font_stats.lookups && font_stats.renders) {
+    ESP_LOGI(TAG, "lookups %" PRIu32 " avg %lld us, renders %" PRIu32 " avg %lld us, cache hit %" PRIu32 "/%" PRIu32,
+      font_stats.lookups, font_stats.lookup_us / font_stats.lookups, font_stats.renders,
+      font_stats.render_us / font_stats.renders, cache.hits, cache.hits + cache.misses);
+  }
+}
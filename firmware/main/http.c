@@ -1,6 +1,7 @@
 #include "esp_http_server.h"
 #include "lwip/sockets.h"
 
+#include "damppi_core.h"
 #include "main.h"
 
 extern nvs_handle_t nvs;
@@ -17,7 +18,8 @@ static const char *HTML_PAGE_TEMPLATE = HTML_PRE
   ":root{--g:12px;--gb:18px}"
   "*{box-sizing:border-box}"
   "label{display:block;font-weight:600;margin:0}"
-  "input{width:100%%;min-width:0;padding:10px;font-size:16px;border:1px solid #ccc;border-radius:10px;margin:0}"
+  "input,textarea{width:100%%;min-width:0;padding:10px;font-size:16px;border:1px solid #ccc;border-radius:10px;"
+  "margin:0}"
   "button{padding:12px 14px;font-size:16px;width:100%%;border-radius:12px;border:none;margin:0}"
   ".card{border:1px solid #ddd;border-radius:12px;padding:14px}"
   ".row{display:flex;gap:var(--g);flex-wrap:wrap}"
@@ -37,9 +39,23 @@ static const char *HTML_PAGE_TEMPLATE = HTML_PRE
   "<div><label>Wi-Fi Password</label><input name='pass' required maxlength='31' value='%s'/></div>"
   "</div>"
   "<div class='row'>"
+  "<div><label>Wi-Fi SSID 2</label><input name='ssid1' maxlength='31' value='%s'/></div>"
+  "<div><label>Wi-Fi Password 2</label><input name='pass1' maxlength='31' value='%s'/></div>"
+  "</div>"
+  "<div class='row'>"
+  "<div><label>Wi-Fi SSID 3</label><input name='ssid2' maxlength='31' value='%s'/></div>"
+  "<div><label>Wi-Fi Password 3</label><input name='pass2' maxlength='31' value='%s'/></div>"
+  "</div>"
+  "<div class='row'>"
   "<div><label>Device Name</label><input name='name' required maxlength='31' value='%s'/></div>"
   "<div><label>Server</label><input name='server' required maxlength='15' inputmode='numeric' value='%s'/></div>"
   "</div>"
+  "<div class='row'>"
+  "<div><label>Broker CA (PEM, enables TLS on port 8883)</label>"
+  "<textarea name='ca' rows='4' style='font-family:monospace' placeholder='%s'></textarea>"
+  "<label style='font-weight:400'><input type='checkbox' name='ca_clear' value='1' style='width:auto'/> "
+  "Remove the installed CA and use plain MQTT</label></div>"
+  "</div>"
   "<div class='actions'>"
   "<button type='submit'>Save</button>"
   "</form>"
@@ -50,57 +66,58 @@ static const char *HTML_PAGE_TEMPLATE = HTML_PRE
   "</div>"
   "</body></html>";
 
+// NVS strings are limited to 4000 bytes including the terminator
+#define CA_MAX 4000
+
 static const char *HTML_OK   = HTML_PRE "<h2>Success</h2><p>Device will be rebooted shortly</p></body></html>";
 static const char *HTML_FAIL = HTML_PRE "<h2>Error</h2><p>Invalid configuration</p></body></html>";
 
-static int hexval(char c) {
-  if (c >= '0' && c <= '9') {
-    return c - '0';
-  }
+static esp_err_t send_html(httpd_req_t *req, const char *html) {
+  httpd_resp_set_type(req, "text/html; charset=utf-8");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  return httpd_resp_send(req, html, HTTPD_RESP_USE_STRLEN);
+}
 
-  if (c >= 'a' && c <= 'f') {
-    return 10 + (c - 'a');
-  }
+// values arrive percent-encoded, so a Hangul name takes 9 bytes per character before decoding
+static esp_err_t form_value(const char *body, const char *key, char *out, size_t size) {
+  // on the heap, a CA certificate would not fit on the httpd stack
+  char *raw = malloc(size * 3);
 
-  if (c >= 'A' && c <= 'F') {
-    return 10 + (c - 'A');
+  if (!raw) {
+    return ESP_ERR_NO_MEM;
   }
 
-  return -1;
-}
-
-static void url_decode_inplace(char *s) {
-  char *o = s;
+  esp_err_t err = httpd_query_key_value(body, key, raw, size * 3);
 
-  for (char *p = s; *p; p++) {
-    if (*p == '+') {
-      *o++ = ' ';
-    } else if (*p == '%' && p[1] && p[2]) {
-      int a = hexval(p[1]), b = hexval(p[2]);
+  if (err == ESP_OK) {
+    url_decode_inplace(raw);
 
-      if (a >= 0 && b >= 0) {
-        *o++ = (char)((a << 4) | b);
-        p += 2;
-      } else {
-        *o++ = *p;
-      }
+    if (strlen(raw) >= size) {
+      err = ESP_ERR_INVALID_SIZE;
     } else {
-      *o++ = *p;
+      strcpy(out, raw);
     }
   }
-  *o = 0;
-}
 
-static esp_err_t send_html(httpd_req_t *req, const char *html) {
-  httpd_resp_set_type(req, "text/html; charset=utf-8");
-  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
-  return httpd_resp_send(req, html, HTTPD_RESP_USE_STRLEN);
+  free(raw);
+  return err;
 }
 
 esp_err_t root_get(httpd_req_t *req) {
-  char out[__builtin_strlen(HTML_PAGE_TEMPLATE) + 120];
-  snprintf(out, sizeof(out), HTML_PAGE_TEMPLATE, hostname, ssid, pass, name, server);
+  device_state_t state;
+  state_get(&state);
+
+  // the page is several KB, on the heap it cannot overflow the httpd stack
+  char *out;
+
+  if (asprintf(&out, HTML_PAGE_TEMPLATE, state.hostname, nets[0].ssid, nets[0].pass, nets[1].ssid, nets[1].pass,
+        nets[2].ssid, nets[2].pass, state.name, state.server,
+        ca_pem ? "Installed, paste a new one to replace" : "None, plain MQTT") < 0) {
+    return httpd_resp_send_500(req);
+  }
+
   send_html(req, out);
+  free(out);
   return ESP_OK;
 }
 
@@ -108,7 +125,7 @@ esp_err_t save_post(httpd_req_t *req) {
   int total    = req->content_len;
   int received = 0;
 
-  if (total <= 0 || total > 2048) {
+  if (total <= 0 || total > 2048 + CA_MAX * 3) {
     httpd_resp_set_status(req, "400 Bad Request");
     return send_html(req, HTML_FAIL);
   }
@@ -133,34 +150,78 @@ esp_err_t save_post(httpd_req_t *req) {
 
   body[total] = '\0';
 
-  char new_ssid[32]   = { 0 };
-  char new_pass[32]   = { 0 };
-  char new_name[32]   = { 0 };
-  char new_server[16] = { 0 };
-  esp_err_t err       = ESP_OK;
+  wifi_net_t new_nets[WIFI_NETS] = { 0 };
+  char new_name[32]              = { 0 };
+  char new_server[16]            = { 0 };
+  char *new_ca                   = calloc(1, CA_MAX);
+  esp_err_t err                  = new_ca ? ESP_OK : ESP_ERR_NO_MEM;
 
-  err |= httpd_query_key_value(body, "ssid", new_ssid, sizeof(new_ssid));
-  err |= httpd_query_key_value(body, "pass", new_pass, sizeof(new_pass));
-  err |= httpd_query_key_value(body, "name", new_name, sizeof(new_name));
-  err |= httpd_query_key_value(body, "server", new_server, sizeof(new_server));
+  for (int i = 0; i < WIFI_NETS; i++) {
+    esp_err_t ssid_err = form_value(body, ssid_keys[i], new_nets[i].ssid, sizeof(new_nets[i].ssid));
+    esp_err_t pass_err = form_value(body, pass_keys[i], new_nets[i].pass, sizeof(new_nets[i].pass));
 
-  url_decode_inplace(new_ssid);
-  url_decode_inplace(new_pass);
-  url_decode_inplace(new_name);
-  url_decode_inplace(new_server);
+    // extra networks may be left out, but a value that is there and does not fit fails the form on every slot;
+    // maxlength counts characters, so a Hangul SSID can pass the page and still be too long in bytes
+    if (i == 0) {
+      err |= ssid_err | pass_err;
+    } else {
+      err |= (ssid_err == ESP_ERR_NOT_FOUND ? ESP_OK : ssid_err) | (pass_err == ESP_ERR_NOT_FOUND ? ESP_OK : pass_err);
+    }
+
+    // a saved SSID needs its password
+    if (i == 0 || new_nets[i].ssid[0]) {
+      if (!new_nets[i].ssid[0] || !new_nets[i].pass[0]) {
+        err |= ESP_FAIL;
+      }
+    } else {
+      new_nets[i] = (wifi_net_t){ 0 };
+    }
+  }
+
+  err |= form_value(body, "name", new_name, sizeof(new_name));
+  err |= form_value(body, "server", new_server, sizeof(new_server));
+
+  // an empty field keeps the installed CA; one that does not fit or is not PEM fails the whole form
+  char clear[2];
+  bool clear_ca = form_value(body, "ca_clear", clear, sizeof(clear)) == ESP_OK;
+
+  if (new_ca) {
+    esp_err_t ca_err = form_value(body, "ca", new_ca, CA_MAX);
+
+    if (ca_err != ESP_OK && ca_err != ESP_ERR_NOT_FOUND) {
+      err |= ca_err;
+    } else if (new_ca[0] && (clear_ca || !strstr(new_ca, "-----BEGIN CERTIFICATE-----"))) {
+      err |= ESP_FAIL;
+    }
+  }
 
   free(body);
 
-  if (err != ESP_OK || !new_ssid[0] || !new_pass[0] || !new_name[0] || !new_server[0] ||
-      inet_pton(AF_INET, new_server, NULL) != 1) {
+  if (err != ESP_OK || !new_name[0] || !new_server[0] || inet_pton(AF_INET, new_server, NULL) != 1) {
+    free(new_ca);
     httpd_resp_set_status(req, "400 Bad Request");
     return send_html(req, HTML_FAIL);
   }
 
-  ESP_ERROR_CHECK(nvs_set_str(nvs, "ssid", new_ssid));
-  ESP_ERROR_CHECK(nvs_set_str(nvs, "pass", new_pass));
+  for (int i = 0; i < WIFI_NETS; i++) {
+    ESP_ERROR_CHECK(nvs_set_str(nvs, ssid_keys[i], new_nets[i].ssid));
+    ESP_ERROR_CHECK(nvs_set_str(nvs, pass_keys[i], new_nets[i].pass));
+  }
+
   ESP_ERROR_CHECK(nvs_set_str(nvs, "name", new_name));
   ESP_ERROR_CHECK(nvs_set_str(nvs, "server", new_server));
+
+  if (new_ca[0]) {
+    ESP_ERROR_CHECK(nvs_set_str(nvs, "ca", new_ca));
+  } else if (clear_ca) {
+    esp_err_t ca_err = nvs_erase_key(nvs, "ca");
+
+    if (ca_err != ESP_ERR_NVS_NOT_FOUND) {
+      ESP_ERROR_CHECK(ca_err);
+    }
+  }
+
+  free(new_ca);
   ESP_ERROR_CHECK(nvs_commit(nvs));
 
   send_html(req, HTML_OK);
@@ -172,13 +233,9 @@ esp_err_t save_post(httpd_req_t *req) {
 
 esp_err_t reset_post(httpd_req_t *req) {
   send_html(req, HTML_OK);
-  ESP_LOGW(TAG, "Erasing NVS");
-
-  ESP_ERROR_CHECK(nvs_erase_all(nvs));
-  ESP_ERROR_CHECK(nvs_commit(nvs));
-  nvs_close(nvs);
+  ESP_LOGW(TAG, "reset from the configuration page");
   vTaskDelay(pdMS_TO_TICKS(200));
-  esp_restart();
+  config_reset(false);
   return ESP_OK;
 }
 
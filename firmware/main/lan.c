@@ -0,0 +1,203 @@
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+#include "mbedtls/constant_time.h"
+
+#include "damppi_core.h"
+#include "main.h"
+
+#define LAN_GROUP "239.255.68.80"
+#define LAN_PORT 24680
+#define LAN_MAGIC "DMP2"
+#define LAN_TAG_LEN 16
+
+// shorter keys, like the old built-in default, are guessable and leave the LAN path off
+#define LAN_KEY_MIN 16
+
+// frame: magic[4] | mac[6] | boot[4, BE] | seq[4, BE] | name_len[1] | name[name_len] | tag[16]
+#define LAN_HDR_LEN (4 + 6 + 4 + 4 + 1)
+#define LAN_MAX_LEN (LAN_HDR_LEN + 31 + LAN_TAG_LEN)
+
+static const char *TAG = "LAN";
+
+static int sock = -1;
+static struct sockaddr_in group;
+
+// boot counter kept in its own namespace, which a configuration reset leaves alone. Receivers refuse boots older
+// than the newest one they saw, so datagrams captured before a reboot cannot be replayed after it.
+#define LAN_BOOT_NAMESPACE "sys"
+#define LAN_BOOT_KEY "lan_boot"
+
+static uint32_t boot;
+
+// only touched from the LAN task
+static replay_t replay;
+
+static int lan_sign(const uint8_t *buf, int len, uint8_t *tag) {
+  uint8_t mac[32];
+  const char *key = CONFIG_DAMPPI_LAN_KEY;
+
+  int ret = mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t *)key, strlen(key), buf,
+    len, mac);
+
+  memcpy(tag, mac, LAN_TAG_LEN);
+  return ret;
+}
+
+void lan_publish(uint32_t seq) {
+  if (sock < 0) {
+    return;
+  }
+
+  device_state_t state;
+  state_get(&state);
+
+  uint8_t tx[LAN_MAX_LEN];
+  int len = strnlen(state.name, 31);
+  int p   = 0;
+
+  memcpy(tx, LAN_MAGIC, 4);
+  p += 4;
+  memcpy(tx + p, dev_mac, 6);
+  p += 6;
+  tx[p++] = boot >> 24;
+  tx[p++] = boot >> 16;
+  tx[p++] = boot >> 8;
+  tx[p++] = boot;
+  tx[p++] = seq >> 24;
+  tx[p++] = seq >> 16;
+  tx[p++] = seq >> 8;
+  tx[p++] = seq;
+  tx[p++] = len;
+  memcpy(tx + p, state.name, len);
+  p += len;
+
+  if (lan_sign(tx, p, tx + p) != 0) {
+    ESP_LOGW(TAG, "sign failed");
+    return;
+  }
+
+  p += LAN_TAG_LEN;
+
+  if (sendto(sock, tx, p, 0, (struct sockaddr *)&group, sizeof(group)) < 0) {
+    ESP_LOGW(TAG, "send failed, errno=%d", errno);
+  }
+}
+
+static void lan_task(void *arg) {
+  uint8_t rx[LAN_MAX_LEN + 1];
+
+  while (true) {
+    int len = recv(sock, rx, sizeof(rx), 0);
+
+    if (len < LAN_HDR_LEN + LAN_TAG_LEN || len > LAN_MAX_LEN || memcmp(rx, LAN_MAGIC, 4)) {
+      continue;
+    }
+
+    int name_len = rx[LAN_HDR_LEN - 1];
+
+    if (LAN_HDR_LEN + name_len + LAN_TAG_LEN != len) {
+      continue;
+    }
+
+    uint8_t tag[LAN_TAG_LEN];
+
+    if (lan_sign(rx, len - LAN_TAG_LEN, tag) != 0 || mbedtls_ct_memcmp(tag, rx + len - LAN_TAG_LEN, LAN_TAG_LEN)) {
+      ESP_LOGW(TAG, "dropped datagram with bad signature");
+      continue;
+    }
+
+    call_id_t id;
+    memcpy(id.mac, rx + 4, 6);
+    uint32_t sender_boot = (uint32_t)rx[10] << 24 | (uint32_t)rx[11] << 16 | (uint32_t)rx[12] << 8 | rx[13];
+    id.seq               = (uint32_t)rx[14] << 24 | (uint32_t)rx[15] << 16 | (uint32_t)rx[16] << 8 | rx[17];
+
+    // the dedup table in call.c is short, a captured datagram must not come back once it has left it
+    if (!replay_check(&replay, id.mac, sender_boot, id.seq)) {
+      BLOGW("dropped replayed datagram from %02X%02X%02X%02X%02X%02X seq %" PRIu32, id.mac[0], id.mac[1],
+        id.mac[2], id.mac[3], id.mac[4], id.mac[5], id.seq);
+      continue;
+    }
+
+    char *buf = msgbuf_get();
+
+    if (!buf) {
+      continue;
+    }
+
+    memcpy(buf, rx + LAN_HDR_LEN, name_len);
+    buf[name_len] = '\0';
+
+    call_recv(&id, CALL_LAN, buf);
+  }
+}
+
+// counts up from 1; 0 if the counter cannot be stored, since reusing a boot would let old datagrams through
+static uint32_t lan_boot(void) {
+  nvs_handle_t sys;
+  uint32_t count = 0;
+
+  if (nvs_open(LAN_BOOT_NAMESPACE, NVS_READWRITE, &sys) != ESP_OK) {
+    return 0;
+  }
+
+  nvs_get_u32(sys, LAN_BOOT_KEY, &count);
+  count++;
+
+  if (nvs_set_u32(sys, LAN_BOOT_KEY, count) != ESP_OK || nvs_commit(sys) != ESP_OK) {
+    count = 0;
+  }
+
+  nvs_close(sys);
+  return count;
+}
+
+esp_err_t lan_init(void) {
+  if (strlen(CONFIG_DAMPPI_LAN_KEY) < LAN_KEY_MIN) {
+    ESP_LOGW(TAG, "DAMPPI_LAN_KEY must have at least %d characters, LAN delivery is off", LAN_KEY_MIN);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  boot = lan_boot();
+
+  if (!boot) {
+    ESP_LOGW(TAG, "boot counter not stored, LAN delivery is off");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+  if (sock < 0) {
+    ESP_LOGE(TAG, "socket create failed");
+    return ESP_FAIL;
+  }
+
+  struct sockaddr_in addr = { 0 };
+  addr.sin_family         = AF_INET;
+  addr.sin_port           = htons(LAN_PORT);
+  addr.sin_addr.s_addr    = htonl(INADDR_ANY);
+
+  struct ip_mreq mreq      = { 0 };
+  mreq.imr_multiaddr.s_addr = inet_addr(LAN_GROUP);
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+  uint8_t ttl = 1;
+
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+      setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+    ESP_LOGE(TAG, "multicast setup failed, errno=%d", errno);
+    close(sock);
+    sock = -1;
+    return ESP_FAIL;
+  }
+
+  group.sin_family      = AF_INET;
+  group.sin_port        = htons(LAN_PORT);
+  group.sin_addr.s_addr = inet_addr(LAN_GROUP);
+
+  xTaskCreate(lan_task, "lan", 3072, NULL, 5, NULL);
+
+  ESP_LOGI(TAG, "joined %s:%d", LAN_GROUP, LAN_PORT);
+
+  return ESP_OK;
+}
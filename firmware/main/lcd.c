@@ -1,85 +1,319 @@
+#include <sys/param.h>
 #include "esp_lcd_io_spi.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_st7789.h"
 #include "esp_lvgl_port.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 
+#include "damppi_core.h"
 #include "main.h"
 
 #define LCD_WIDTH 172
 #define LCD_HEIGHT 320
 #define BACKLIGHT GPIO_NUM_22
 
-#define UI_QUEUE_LEN 4
-#define MAX_TEXT_LEN 128
+#define UI_RING_LEN 8
 
 extern const lv_image_dsc_t logo;
 
+static const char *TAG = "LCD";
+
+#define CALL_TEXT "called everyone!"
+#define CALL_FLASH_MS 250
+#define CALL_FLASH_COUNT 3
+#define CALL_PULSE_MS 600
+
 static esp_lcd_panel_handle_t lcd = NULL;
-static QueueHandle_t ui_queue     = NULL;
+static TaskHandle_t ui_handle     = NULL;
 static lv_obj_t *ui_label         = NULL;
 
+static lv_obj_t *call_flash = NULL;
+static lv_obj_t *call_name  = NULL;
+static lv_obj_t *call_sub   = NULL;
+static lv_obj_t *call_bar   = NULL;
+
+// held while the screen is on, so animations and SPI flushes run at full clock without light sleep in between
+static esp_pm_lock_handle_t ui_pm;
+static bool ui_awake;
+
 typedef struct {
   const lv_font_t *font;
-  char text[MAX_TEXT_LEN];
+  char *text;  // pool buffer owned by the message; NULL or empty shows the status screen
   int timeout;
+  bool call;
 } ui_msg_t;
 
+// messages from any task to the UI task; a sender never waits, a full ring drops the message
+static mpsc_t ui_ring;
+static uint8_t ui_ring_buf[MPSC_BUF_SIZE(sizeof(ui_msg_t), UI_RING_LEN)] __attribute__((aligned(4)));
+
+// frame timing, updated from the LVGL task
+lcd_stats_t lcd_stats;
+static int64_t frame_start;
+static int64_t render_start;
+static int64_t flush_start;
+
+static void ui_frame_cb(lv_event_t *e) {
+  int64_t now = esp_timer_get_time();
+
+  switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+      // an animation that misses a whole refresh period is a dropped frame
+      if (frame_start && lv_anim_count_running() && now - frame_start > 2 * LV_DEF_REFR_PERIOD * 1000) {
+        lcd_stats.dropped++;
+      }
+
+      frame_start = now;
+      break;
+    case LV_EVENT_RENDER_START:
+      render_start = now;
+      break;
+    case LV_EVENT_RENDER_READY:
+      lcd_stats.frames++;
+      lcd_stats.render_us += now - render_start;
+      lcd_stats.render_max_us = MAX(lcd_stats.render_max_us, now - render_start);
+      break;
+    case LV_EVENT_FLUSH_WAIT_START:
+      flush_start = now;
+      break;
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+      lcd_stats.flush_us += now - flush_start;
+      lcd_stats.flush_max_us = MAX(lcd_stats.flush_max_us, now - flush_start);
+      break;
+    default:
+      break;
+  }
+}
+
+static void anim_bg_opa(void *obj, int32_t v) {
+  lv_obj_set_style_bg_opa(obj, v, 0);
+}
+
+static void anim_text_opa(void *obj, int32_t v) {
+  lv_obj_set_style_text_opa(obj, v, 0);
+}
+
+static void anim_bar(void *obj, int32_t v) {
+  lv_bar_set_value(obj, v, LV_ANIM_OFF);
+}
+
+static void ui_anim(lv_obj_t *obj, lv_anim_exec_xcb_t cb, int32_t from, int32_t to, uint32_t ms, uint32_t repeat,
+  bool playback) {
+  lv_anim_t a;
+  lv_anim_init(&a);
+  lv_anim_set_var(&a, obj);
+  lv_anim_set_exec_cb(&a, cb);
+  lv_anim_set_values(&a, from, to);
+  lv_anim_set_duration(&a, ms);
+  lv_anim_set_repeat_count(&a, repeat);
+
+  if (playback) {
+    lv_anim_set_playback_duration(&a, ms);
+  }
+
+  lv_anim_start(&a);
+}
+
+static void ui_create(void) {
+  lv_obj_t *scr = lv_screen_active();
+  lv_obj_clean(scr);
+
+  // full screen overlay behind the text, faded in and out to flash the whole display
+  call_flash = lv_obj_create(scr);
+  lv_obj_remove_style_all(call_flash);
+  lv_obj_set_size(call_flash, LV_PCT(100), LV_PCT(100));
+  lv_obj_set_style_bg_color(call_flash, lv_palette_main(LV_PALETTE_ORANGE), 0);
+  lv_obj_set_style_bg_opa(call_flash, LV_OPA_TRANSP, 0);
+
+  ui_label = lv_label_create(scr);
+  lv_obj_set_style_text_color(ui_label, lv_color_white(), 0);
+  lv_obj_set_style_text_align(ui_label, LV_TEXT_ALIGN_CENTER, 0);
+  lv_label_set_text(ui_label, "");
+
+  // names wider than the screen scroll as a marquee instead of being cut off
+  call_name = lv_label_create(scr);
+  lv_obj_set_width(call_name, LCD_HEIGHT - 20);
+  lv_obj_set_style_text_color(call_name, lv_color_white(), 0);
+  lv_obj_set_style_text_align(call_name, LV_TEXT_ALIGN_CENTER, 0);
+  lv_obj_set_style_text_font(call_name, LV_FONT(30), 0);
+  lv_label_set_long_mode(call_name, LV_LABEL_LONG_SCROLL_CIRCULAR);
+  lv_obj_align(call_name, LV_ALIGN_CENTER, 0, -24);
+
+  call_sub = lv_label_create(scr);
+  lv_obj_set_style_text_color(call_sub, lv_color_white(), 0);
+  lv_obj_set_style_text_font(call_sub, LV_FONT(24), 0);
+  lv_label_set_text(call_sub, CALL_TEXT);
+  lv_obj_align(call_sub, LV_ALIGN_CENTER, 0, 20);
+
+  // remaining time until the call times out
+  call_bar = lv_bar_create(scr);
+  lv_obj_set_size(call_bar, LCD_HEIGHT - 20, 8);
+  lv_obj_set_style_bg_color(call_bar, lv_palette_main(LV_PALETTE_ORANGE), LV_PART_INDICATOR);
+  lv_obj_align(call_bar, LV_ALIGN_BOTTOM_MID, 0, -12);
+}
+
+static void ui_call_show(bool show) {
+  lv_obj_t *objs[] = { call_name, call_sub, call_bar };
+
+  for (int i = 0; i < sizeof(objs) / sizeof(objs[0]); i++) {
+    if (show) {
+      lv_obj_remove_flag(objs[i], LV_OBJ_FLAG_HIDDEN);
+    } else {
+      lv_obj_add_flag(objs[i], LV_OBJ_FLAG_HIDDEN);
+    }
+  }
+
+  if (show) {
+    lv_obj_add_flag(ui_label, LV_OBJ_FLAG_HIDDEN);
+  } else {
+    lv_obj_remove_flag(ui_label, LV_OBJ_FLAG_HIDDEN);
+  }
+}
+
+static void ui_call_stop(void) {
+  lv_anim_delete(call_flash, NULL);
+  lv_anim_delete(call_name, NULL);
+  lv_anim_delete(call_bar, NULL);
+
+  lv_obj_set_style_bg_opa(call_flash, LV_OPA_TRANSP, 0);
+  lv_obj_set_style_text_opa(call_name, LV_OPA_COVER, 0);
+  ui_call_show(false);
+}
+
+static void ui_call_start(const char *name, int timeout) {
+  ui_call_stop();
+
+  lv_label_set_text(call_name, name);
+  lv_bar_set_range(call_bar, 0, timeout);
+  lv_bar_set_value(call_bar, timeout, LV_ANIM_OFF);
+  ui_call_show(true);
+
+  ui_anim(call_flash, anim_bg_opa, LV_OPA_TRANSP, LV_OPA_COVER, CALL_FLASH_MS, CALL_FLASH_COUNT, true);
+  ui_anim(call_name, anim_text_opa, LV_OPA_COVER, LV_OPA_40, CALL_PULSE_MS, LV_ANIM_REPEAT_INFINITE, true);
+  ui_anim(call_bar, anim_bar, timeout, 0, timeout, 1, false);
+}
+
+static void ui_log_stats(void) {
+  if (lcd_stats.frames) {
+    ESP_LOGI(TAG, "frames %" PRIu32 ", dropped %" PRIu32 ", render avg/max %lld/%lld us, flush avg/max %lld/%lld us",
+      lcd_stats.frames, lcd_stats.dropped, lcd_stats.render_us / lcd_stats.frames, lcd_stats.render_max_us,
+      lcd_stats.flush_us / lcd_stats.frames, lcd_stats.flush_max_us);
+  }
+
+  font_log_stats();
+}
+
+static void ui_wake(bool on) {
+  if (on == ui_awake) {
+    return;
+  }
+
+  ui_awake = on;
+
+  // with the screen off the 5 ms LVGL tick would wake the chip 200 times a second for nothing
+  if (on) {
+    esp_pm_lock_acquire(ui_pm);
+    lvgl_port_resume();
+  } else {
+    lvgl_port_stop();
+    esp_pm_lock_release(ui_pm);
+  }
+}
+
 void ui_task(void *arg) {
   ui_msg_t msg;
   TickType_t wait = portMAX_DELAY;
   bool first      = true;
 
   while (true) {
-    if (xQueueReceive(ui_queue, &msg, wait)) {
+    if (mpsc_pop(&ui_ring, &msg)) {
+      ui_wake(true);
       gpio_set_level(BACKLIGHT, 1);
       esp_lcd_panel_disp_on_off(lcd, true);
 
       lvgl_port_lock(0);
 
       if (first) {
-        lv_obj_clean(lv_screen_active());
-
-        ui_label = lv_label_create(lv_screen_active());
-        lv_obj_set_style_text_color(ui_label, lv_color_white(), 0);
-        lv_obj_set_style_text_align(ui_label, LV_TEXT_ALIGN_CENTER, 0);
-        lv_label_set_text(ui_label, "");
-
+        ui_create();
         first = false;
       }
 
-      if (msg.text[0]) {
+      if (msg.call) {
+        ui_call_start(msg.text, msg.timeout);
+      } else if (msg.text && msg.text[0]) {
+        ui_call_stop();
         lv_obj_set_style_text_font(ui_label, msg.font, 0);
         lv_label_set_text(ui_label, msg.text);
         lv_obj_center(ui_label);
       } else {
+        device_state_t state;
+        state_get(&state);
+
+        ui_call_stop();
         lv_obj_set_style_text_font(ui_label, LV_FONT(24), 0);
-        lv_label_set_text_fmt(ui_label, "%s", status); 
+        lv_label_set_text(ui_label, state.status);
         lv_obj_center(ui_label);
       }
 
       lvgl_port_unlock();
+      msgbuf_put(msg.text);
 
       wait = msg.timeout ? pdMS_TO_TICKS(msg.timeout) : portMAX_DELAY;
-    } else {
+    } else if (!ulTaskNotifyTake(pdTRUE, wait)) {
+      // nothing new within the timeout; a message pushed after the pop above leaves its notification pending
+      lvgl_port_lock(0);
+      ui_call_stop();
+      lvgl_port_unlock();
+      ui_log_stats();
+
       esp_lcd_panel_disp_on_off(lcd, false);
       gpio_set_level(BACKLIGHT, 0);
+      ui_wake(false);
       wait = portMAX_DELAY;
     }
   }
 }
 
+// takes ownership of text, a pool buffer rendered by the UI task
+static void ui_send(const lv_font_t *font, int timeout, char *text, bool call) {
+  ui_msg_t msg = {
+    .font    = font,
+    .text    = text,
+    .timeout = timeout,
+    .call    = call,
+  };
+
+  if (!mpsc_push(&ui_ring, &msg)) {
+    msgbuf_put(text);
+    return;
+  }
+
+  xTaskNotifyGive(ui_handle);
+}
+
+void lcd_call(char *name, int timeout) {
+  ui_send(LV_FONT(30), timeout, name, true);
+}
+
 void lcd_printf(const lv_font_t *font, int timeout, const char *fmt, ...) {
-  ui_msg_t msg;
-  msg.font    = font;
-  msg.timeout = timeout;
+  char *text = msgbuf_get();
+
+  if (!text) {
+    return;
+  }
 
   va_list ap;
   va_start(ap, fmt);
-  vsnprintf(msg.text, MAX_TEXT_LEN, fmt, ap);
+  bool truncated = msg_vformat(text, MSGBUF_SIZE, fmt, ap);
   va_end(ap);
 
-  xQueueSend(ui_queue, &msg, pdMS_TO_TICKS(10));
+  if (truncated) {
+    msgbuf_truncated();
+  }
+
+  ui_send(font, timeout, text, false);
 }
 
 esp_err_t lcd_init(void) {
@@ -153,19 +387,24 @@ esp_err_t lcd_init(void) {
     },
   };
 
-  lvgl_port_add_disp(&disp_cfg);
+  lv_display_t *disp = lvgl_port_add_disp(&disp_cfg);
 
   lvgl_port_lock(0);
   lv_obj_set_style_bg_color(lv_screen_active(), lv_color_black(), 0);
   lv_obj_t *img = lv_image_create(lv_screen_active());
   lv_image_set_src(img, &logo);
   lv_obj_center(img);
+  lv_display_add_event_cb(disp, ui_frame_cb, LV_EVENT_ALL, NULL);
   lvgl_port_unlock();
 
   gpio_set_level(BACKLIGHT, true);
 
-  ui_queue = xQueueCreate(UI_QUEUE_LEN, sizeof(ui_msg_t));
-  xTaskCreate(ui_task, "ui", 4096, NULL, 5, NULL);
+  // the boot logo stays up until the first message times out; without power management the lock is a no-op
+  esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ui", &ui_pm);
+  ui_wake(true);
+
+  mpsc_init(&ui_ring, ui_ring_buf, sizeof(ui_msg_t), UI_RING_LEN);
+  xTaskCreate(ui_task, "ui", 4096, NULL, 5, &ui_handle);
 
   return ESP_OK;
 }
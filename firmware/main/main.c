@@ -3,73 +3,104 @@
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "driver/gpio.h"
+#include "hal/gpio_ll.h"
 #include "lwip/sockets.h"
 
+#include "damppi_core.h"
 #include "main.h"
 
-#define BTN_DEBOUNCE_MS 50
-#define BTN_MIN_GAP_MS 200
-#define BTN_DBL_CLK_MS 500
+// optional NVS partition holding a unit's configuration, see tools/provision.py
+#define FACTORY_PARTITION "fctry"
+
+// set by a user reset; the factory configuration is not imported again until a factory reset clears it
+#define NO_IMPORT_KEY "noimport"
+
+// stamp of the factory image, new in every image provision.py writes; nvs keeps the last one imported
+#define STAMP_NAMESPACE "sys"
+#define STAMP_KEY "stamp"
+
+// how long the reset button is held for a reset to the AP, and for a reset to the factory configuration
+#define RESET_HOLD_US (3 * 1000 * 1000)
+#define FACTORY_HOLD_US (10 * 1000 * 1000)
+
+#define RESET_USER 1
+#define RESET_FACTORY 2
 
 esp_err_t lcd_init(void);
 
 void wifi_softap(void);
-void wifi_sta(const char *ssid, const char *pass);
+void wifi_sta(void);
+void call_init(void);
+void power_init(void);
 
 nvs_handle_t nvs;
-char ssid[32];
-char pass[32];
-char name[32];
-char server[16];
-char hostname[16];
+wifi_net_t nets[WIFI_NETS];
+const char *const ssid_keys[WIFI_NETS] = { "ssid", "ssid1", "ssid2" };
+const char *const pass_keys[WIFI_NETS] = { "pass", "pass1", "pass2" };
+uint8_t dev_mac[6];
+char *ca_pem;
 
 static const char *TAG = "APP";
 
 static TaskHandle_t btn_task;
 static TaskHandle_t reset_task;
 
-static void IRAM_ATTR btn_isr(void *arg) {
-  static int64_t last_isr_time   = 0;
-  static int64_t last_click_time = 0;
+typedef struct {
+  int64_t time;
+  uint8_t event;
+} btn_msg_t;
 
-  int64_t now = esp_timer_get_time();
+// button events from the ISR to the button task, with their timestamps
+static spsc_t btn_ring;
+static btn_msg_t btn_ring_buf[8];
 
-  if (now - last_isr_time < BTN_DEBOUNCE_MS * 1000) {
-    return;
-  }
+int64_t btn_latency_max_us;
 
-  last_isr_time = now;
+// only a level can wake the chip from light sleep, so the buttons interrupt on the level opposite to the one just
+// read instead of on edges; every press and release still reaches the ISR, and the wake level follows along.
+// The LL call is inlined and takes no lock, unlike gpio_set_intr_type().
+static inline int gpio_follow(gpio_num_t pin) {
+  int level = gpio_get_level(pin);
+  gpio_ll_set_intr_type(&GPIO, pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  return level;
+}
 
-  if (gpio_get_level(GPIO_NUM_23)) {
-    return;
-  }
+static void IRAM_ATTR btn_isr(void *arg) {
+  static btn_state_t state;
 
-  int64_t diff = now - last_click_time;
+  btn_msg_t msg = { .time = esp_timer_get_time() };
+  msg.event     = btn_event(&state, msg.time, gpio_follow(GPIO_NUM_23));
 
-  if (diff < BTN_DBL_CLK_MS * 1000) {
-    if (diff > BTN_MIN_GAP_MS * 1000) {
-      last_click_time = 0;
-      xTaskNotifyFromISR(btn_task, 2, eSetBits, NULL);
-    }
-  } else {
-    last_click_time = now;
-    xTaskNotifyFromISR(btn_task, 1, eSetBits, NULL);
+  if (msg.event != BTN_CLICK && msg.event != BTN_DBL_CLICK) {
+    return;
   }
 
-  portYIELD_FROM_ISR();
+  // a full ring means the task is far behind; the press is dropped rather than waited for
+  if (spsc_push(&btn_ring, &msg)) {
+    vTaskNotifyGiveFromISR(btn_task, NULL);
+    portYIELD_FROM_ISR();
+  }
 }
 
 static void btn_handler(void *arg) {
-  uint32_t val;
+  btn_msg_t msg;
 
   while (true) {
-    if (xTaskNotifyWait(0, ULONG_MAX, &val, portMAX_DELAY)) {
-      if (val & 1) {
-        lcd_printf(LV_FONT(30), 3 * 1000, "");
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    while (spsc_pop(&btn_ring, &msg)) {
+      // ISR to task latency, to make sure UI rendering never holds back a press
+      int64_t latency = esp_timer_get_time() - msg.time;
+
+      if (latency > btn_latency_max_us) {
+        btn_latency_max_us = latency;
+        ESP_LOGI(TAG, "button latency max %lld us", latency);
       }
 
-      if (val & 2) {
-        mqtt_publish();
+      if (msg.event == BTN_CLICK) {
+        lcd_printf(LV_FONT(30), 3 * 1000, "");
+      } else {
+        call_send();
       }
     }
   }
@@ -81,37 +112,146 @@ static void btn_init(void) {
     .mode         = GPIO_MODE_INPUT,
     .pull_up_en   = GPIO_PULLUP_ENABLE,
     .pull_down_en = GPIO_PULLDOWN_DISABLE,
-    .intr_type    = GPIO_INTR_NEGEDGE,
+    .intr_type    = GPIO_INTR_LOW_LEVEL,
   };
 
+  spsc_init(&btn_ring, btn_ring_buf, sizeof(btn_msg_t), sizeof(btn_ring_buf) / sizeof(btn_ring_buf[0]));
+
+  // above the LVGL task so animations cannot delay a press; the stack holds a device_state_t copy in call_send
+  xTaskCreate(btn_handler, "btn", 3072, NULL, 6, &btn_task);
+
   ESP_ERROR_CHECK(gpio_config(&gpio));
   ESP_ERROR_CHECK(gpio_isr_handler_add(GPIO_NUM_23, btn_isr, NULL));
-
-  xTaskCreate(btn_handler, "btn", 2048, NULL, 3, &btn_task);
+  ESP_ERROR_CHECK(gpio_wakeup_enable(GPIO_NUM_23, GPIO_INTR_LOW_LEVEL));
 }
 
 static void reset_isr(void *arg) {
   gpio_num_t pin      = (gpio_num_t)arg;
   static int64_t last = 0;
 
-  if (!gpio_get_level(pin)) {
+  if (!gpio_follow(pin)) {
     last = esp_timer_get_time();
-  } else if (esp_timer_get_time() - last > (3 * 1000 * 1000)) {
-    vTaskNotifyGiveFromISR(reset_task, NULL);
+  } else {
+    int64_t held = esp_timer_get_time() - last;
+
+    if (held > RESET_HOLD_US) {
+      xTaskNotifyFromISR(reset_task, held > FACTORY_HOLD_US ? RESET_FACTORY : RESET_USER, eSetValueWithOverwrite,
+        NULL);
+    }
   }
 
   portYIELD_FROM_ISR();
 }
 
+void config_reset(bool factory) {
+  ESP_LOGW(TAG, "Erasing NVS%s", factory ? ", back to the factory configuration" : "");
+
+  ESP_ERROR_CHECK(nvs_erase_all(nvs));
+
+  if (!factory) {
+    ESP_ERROR_CHECK(nvs_set_u8(nvs, NO_IMPORT_KEY, 1));
+  }
+
+  ESP_ERROR_CHECK(nvs_commit(nvs));
+  nvs_close(nvs);
+  esp_restart();
+}
+
 static void reset_handler(void *arg) {
+  uint32_t kind;
+
   while (true) {
-    ulTaskNotifyTake(true, portMAX_DELAY);
+    xTaskNotifyWait(0, 0, &kind, portMAX_DELAY);
+    config_reset(kind == RESET_FACTORY);
+  }
+}
+
+// copies the configuration flashed into the factory partition by tools/provision.py, so a provisioned unit
+// comes up online on first boot and again after a factory reset. esptool leaves the nvs partition alone, so an
+// image with a stamp this unit has not imported yet replaces whatever configuration it had before
+static void provision_import(void) {
+  bool unset = nvs_get_str(nvs, "name", NULL, &(size_t){ 0 }) == ESP_ERR_NVS_NOT_FOUND &&
+               nvs_get_u8(nvs, NO_IMPORT_KEY, &(uint8_t){ 0 }) == ESP_ERR_NVS_NOT_FOUND;
+
+  if (nvs_flash_init_partition(FACTORY_PARTITION) != ESP_OK) {
+    return;
+  }
 
-    ESP_LOGW(TAG, "Erasing NVS");
+  int64_t start = esp_timer_get_time();
+  int count     = 0;
+
+  nvs_handle_t factory, sys;
+  nvs_iterator_t it = NULL;
+  char stamp[64]    = { 0 };
+  char seen[64]     = { 0 };
+
+  if (nvs_open_from_partition(FACTORY_PARTITION, STAMP_NAMESPACE, NVS_READONLY, &factory) == ESP_OK) {
+    nvs_get_str(factory, STAMP_KEY, stamp, &(size_t){ sizeof(stamp) });
+    nvs_close(factory);
+  }
+
+  // kept outside "cfg", so neither reset makes an old image look new
+  bool has_sys = nvs_open(STAMP_NAMESPACE, NVS_READWRITE, &sys) == ESP_OK;
+
+  if (has_sys) {
+    nvs_get_str(sys, STAMP_KEY, seen, &(size_t){ sizeof(seen) });
+  }
+
+  bool fresh = stamp[0] && strcmp(stamp, seen);
+
+  if ((!fresh && !unset) || nvs_open_from_partition(FACTORY_PARTITION, "cfg", NVS_READONLY, &factory) != ESP_OK) {
+    if (has_sys) {
+      nvs_close(sys);
+    }
+
+    nvs_flash_deinit_partition(FACTORY_PARTITION);
+    return;
+  }
+
+  if (fresh) {
+    ESP_LOGI(TAG, "new factory image %s, replacing the configuration", stamp);
     ESP_ERROR_CHECK(nvs_erase_all(nvs));
+  }
+
+  esp_err_t res = nvs_entry_find(FACTORY_PARTITION, "cfg", NVS_TYPE_STR, &it);
+
+  while (res == ESP_OK) {
+    nvs_entry_info_t info;
+    size_t len;
+
+    nvs_entry_info(it, &info);
+
+    if (nvs_get_str(factory, info.key, NULL, &len) == ESP_OK) {
+      char *value = malloc(len);
+
+      if (value && nvs_get_str(factory, info.key, value, &len) == ESP_OK &&
+          nvs_set_str(nvs, info.key, value) == ESP_OK) {
+        count++;
+      }
+
+      free(value);
+    }
+
+    res = nvs_entry_next(&it);
+  }
+
+  nvs_release_iterator(it);
+  nvs_close(factory);
+  nvs_flash_deinit_partition(FACTORY_PARTITION);
+
+  if (count || fresh) {
     ESP_ERROR_CHECK(nvs_commit(nvs));
-    nvs_close(nvs);
-    esp_restart();
+    ESP_LOGI(TAG, "provisioned %d keys from the factory partition in %lld ms", count,
+      (esp_timer_get_time() - start) / 1000);
+  }
+
+  // only once the configuration is committed, a power cut before this imports the image again
+  if (has_sys) {
+    if (fresh && (nvs_set_str(sys, STAMP_KEY, stamp) != ESP_OK || nvs_commit(sys) != ESP_OK)) {
+      ESP_LOGW(TAG, "factory image stamp not stored, it is imported again on the next boot");
+    }
+
+    nvs_close(sys);
   }
 }
 
@@ -122,15 +262,24 @@ static void reset_init(void) {
   gpio.mode         = GPIO_MODE_INPUT;
   gpio.pull_up_en   = GPIO_PULLUP_ENABLE;
   gpio.pull_down_en = GPIO_PULLDOWN_DISABLE;
-  gpio.intr_type    = GPIO_INTR_ANYEDGE;
+  gpio.intr_type    = GPIO_INTR_LOW_LEVEL;
 
   ESP_ERROR_CHECK(gpio_config(&gpio));
   ESP_ERROR_CHECK(gpio_isr_handler_add(GPIO_NUM_9, reset_isr, (void *)GPIO_NUM_9));
+  ESP_ERROR_CHECK(gpio_wakeup_enable(GPIO_NUM_9, GPIO_INTR_LOW_LEVEL));
 
   xTaskCreate(reset_handler, "reset", 2048, NULL, 10, &reset_task);
 }
 
 void app_main(void) {
+  blog_init();
+#if CONFIG_DAMPPI_BLOG_BENCH
+  blog_bench();
+#endif
+  power_init();
+  state_init();
+  msgbuf_init();
+  font_init();
   lcd_init();
 
   ESP_ERROR_CHECK(gpio_install_isr_service(0));
@@ -139,29 +288,49 @@ void app_main(void) {
   ESP_ERROR_CHECK(nvs_flash_init());
   ESP_ERROR_CHECK(nvs_open("cfg", NVS_READWRITE, &nvs));
 
+  provision_import();
+
   esp_err_t err = ESP_OK;
 
-  size_t size = sizeof(ssid);
-  err |= nvs_get_str(nvs, "ssid", ssid, &size);
+  size_t size;
+
+  for (int i = 0; i < WIFI_NETS; i++) {
+    size               = sizeof(nets[i].ssid);
+    esp_err_t ssid_err = nvs_get_str(nvs, ssid_keys[i], nets[i].ssid, &size);
 
-  size = sizeof(pass);
-  err |= nvs_get_str(nvs, "pass", pass, &size);
+    size               = sizeof(nets[i].pass);
+    esp_err_t pass_err = nvs_get_str(nvs, pass_keys[i], nets[i].pass, &size);
 
-  size = sizeof(name);
-  err |= nvs_get_str(nvs, "name", name, &size);
+    // only the first network is required
+    if (i == 0) {
+      err |= ssid_err | pass_err;
+    }
+  }
 
-  size = sizeof(server);
-  err |= nvs_get_str(nvs, "server", server, &size);
+  device_state_t state = { 0 };
+
+  size = sizeof(state.name);
+  err |= nvs_get_str(nvs, "name", state.name, &size);
+
+  size = sizeof(state.server);
+  err |= nvs_get_str(nvs, "server", state.server, &size);
+
+  // optional; a provisioned CA switches the broker connection to TLS
+  if (nvs_get_str(nvs, "ca", NULL, &size) == ESP_OK && size > 1 && (ca_pem = malloc(size))) {
+    nvs_get_str(nvs, "ca", ca_pem, &size);
+  }
 
-  uint8_t mac[6];
-  ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
-  snprintf(hostname, sizeof(hostname), "Damppi %02X%02X%02X", mac[3], mac[4], mac[5]);
+  ESP_ERROR_CHECK(esp_read_mac(dev_mac, ESP_MAC_WIFI_STA));
+  snprintf(state.hostname, sizeof(state.hostname), "Damppi %02X%02X%02X", dev_mac[3], dev_mac[4], dev_mac[5]);
+  state_publish(&state);
 
-  if (err != ESP_OK || !ssid[0] || !pass[0] || !name[0] || !server[0] || inet_pton(AF_INET, server, NULL) != 1) {
+  if (err != ESP_OK || !nets[0].ssid[0] || !nets[0].pass[0] || !state.name[0] || !state.server[0] ||
+      inet_pton(AF_INET, state.server, NULL) != 1) {
     wifi_softap();
   } else {
+    call_init();
     btn_init();
-    wifi_sta(ssid, pass);
+    wifi_sta();
   }
 
   return;
@@ -3,19 +3,223 @@
 
 #include "esp_log.h"
 #include "esp_lvgl_port.h"
+#include "esp_transport.h"
 #include "nvs_flash.h"
 
-#define LV_FONT(size) (&lv_font_montserrat_##size)
+#include "damppi_core.h"
 
-extern char ssid[32];
-extern char pass[32];
-extern char name[32];
-extern char server[16];
-extern char hostname[16];
+// Montserrat with a Hangul/CJK fallback from the font partition, see font.c
+#define LV_FONT(size) (&font_##size)
 
-extern char status[128];
+extern lv_font_t font_24;
+extern lv_font_t font_30;
 
-void mqtt_publish(void);
+#define MSGBUF_SIZE 256
+
+#define WIFI_NETS 3
+
+typedef struct {
+  char ssid[32];
+  char pass[32];
+} wifi_net_t;
+
+// saved networks; the first one is required, the others may be empty
+extern wifi_net_t nets[WIFI_NETS];
+extern const char *const ssid_keys[WIFI_NETS];
+extern const char *const pass_keys[WIFI_NETS];
+
+// device state shared between tasks; readers get a consistent copy, writers publish a whole new one.
+// Fields are set once at boot except ssid and status, which only the Wi-Fi event task updates.
+typedef struct {
+  char ssid[33];
+  char name[32];
+  char server[16];
+  char hostname[16];
+  char status[128];
+} device_state_t;
+
+void state_init(void);
+void state_get(device_state_t *out);
+void state_publish(const device_state_t *state);
+
+// erases the configuration and restarts. After a user reset the unit comes up as an AP even if it was
+// provisioned, so one with wrong provisioned credentials can still be set up by hand; a factory reset
+// imports the factory partition again.
+void config_reset(bool factory);
+
+// broker CA in PEM, NULL for plain MQTT
+extern char *ca_pem;
+
+extern uint8_t dev_mac[6];
+
+typedef enum {
+  CALL_MQTT,
+  CALL_LAN,
+} call_path_t;
+
+typedef struct {
+  uint8_t mac[6];
+  uint32_t seq;
+} call_id_t;
+
+typedef struct {
+  uint32_t truncated;
+  uint32_t exhausted;
+} msgbuf_stats_t;
+
+extern msgbuf_stats_t msgbuf_stats;
+
+// fixed pool of MSGBUF_SIZE buffers; ownership moves with the pointer and the last owner puts it back
+void msgbuf_init(void);
+char *msgbuf_get(void);
+void msgbuf_put(char *buf);
+void msgbuf_truncated(void);
+
+typedef struct {
+  uint32_t sent;
+  uint32_t limited;
+  uint32_t received;
+  uint32_t duplicates;
+  uint32_t coalesced;
+} call_stats_t;
+
+extern call_stats_t call_stats;
+
+bool call_send(void);
+void call_recv(const call_id_t *id, call_path_t path, char *name);
+
+void api_event(const char *type, const char *text);
+
+void mqtt_publish(uint32_t seq);
+void lan_publish(uint32_t seq);
 void lcd_printf(const lv_font_t *font, int timeout, const char *fmt, ...);
+void lcd_call(char *name, int timeout);
+
+typedef struct {
+  uint32_t frames;
+  uint32_t dropped;
+  int64_t render_us;
+  int64_t render_max_us;
+  int64_t flush_us;
+  int64_t flush_max_us;
+} lcd_stats_t;
+
+extern lcd_stats_t lcd_stats;
+
+typedef struct {
+  uint32_t lookups;
+  int64_t lookup_us;
+  uint32_t renders;
+  int64_t render_us;
+  uint32_t cache_hits;
+  uint32_t cache_misses;
+} font_stats_t;
+
+extern font_stats_t font_stats;
+
+void font_init(void);
+void font_log_stats(void);
+extern int64_t btn_latency_max_us;
+
+#define MQTT_TLS_PORT 8883
+
+typedef struct {
+  uint32_t count;
+  int64_t last_us;
+  size_t heap_peak;
+} tls_handshake_t;
+
+typedef struct {
+  tls_handshake_t full;
+  tls_handshake_t resumed;
+} tls_stats_t;
+
+extern tls_stats_t tls_stats;
+
+esp_transport_handle_t tls_transport(const char *ca);
+
+typedef enum {
+  LINK_WIFI,
+  LINK_MQTT,
+  LINK_COUNT,
+} link_t;
+
+typedef struct {
+  uint32_t attempts;
+  uint32_t connects;
+  uint32_t resets;
+  int delay_ms;
+} reconnect_stats_t;
+
+// one backoff schedule per link; retry runs on the default event loop once the jittered delay has passed.
+// reconnect_init needs the default event loop.
+void reconnect_init(void);
+void reconnect_down(link_t link, void (*retry)(void));
+void reconnect_up(link_t link);
+// drops a pending retry and starts the backoff over, for a link whose path has just come back
+void reconnect_reset(link_t link);
+void reconnect_stats(link_t link, reconnect_stats_t *out);
+
+typedef struct {
+  uint32_t sleeps;
+  int64_t sleep_us;
+} power_stats_t;
+
+// CONFIG_DAMPPI_POWER mode name and the time spent in automatic light sleep
+extern const char *const power_mode;
+void power_stats(power_stats_t *out);
+
+// binary log into a RAM ring, downloaded from /api/log and formatted by tools/blogdump.py. Like ESP_LOGx it uses
+// the file's TAG. Only the string addresses and the raw arguments are stored, so the call costs a few copies
+// instead of formatting and UART output.
+// Arguments are integers, 64-bit integers, doubles and strings (cut at BLOG_STR_MAX); at most 8 per call.
+#define BLOG_ERROR 'E'
+#define BLOG_WARN 'W'
+#define BLOG_INFO 'I'
+
+#define BLOG_ARG(r, x)                \
+  _Generic((x),                       \
+    char *: blog_put_str,             \
+    const char *: blog_put_str,       \
+    long long: blog_put_u64,          \
+    unsigned long long: blog_put_u64, \
+    float: blog_put_f64,              \
+    double: blog_put_f64,             \
+    default: blog_put_u32)(r, x);
+
+#define BLOG_EACH_0(r)
+#define BLOG_EACH_1(r, a) BLOG_ARG(r, a)
+#define BLOG_EACH_2(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_1(r, __VA_ARGS__)
+#define BLOG_EACH_3(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_2(r, __VA_ARGS__)
+#define BLOG_EACH_4(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_3(r, __VA_ARGS__)
+#define BLOG_EACH_5(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_4(r, __VA_ARGS__)
+#define BLOG_EACH_6(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_5(r, __VA_ARGS__)
+#define BLOG_EACH_7(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_6(r, __VA_ARGS__)
+#define BLOG_EACH_8(r, a, ...) BLOG_ARG(r, a) BLOG_EACH_7(r, __VA_ARGS__)
+#define BLOG_PICK(_0, _1, _2, _3, _4, _5, _6, _7, _8, each, ...) each
+#define BLOG_EACH(r, ...)                                                                                    \
+  BLOG_PICK(_0, ##__VA_ARGS__, BLOG_EACH_8, BLOG_EACH_7, BLOG_EACH_6, BLOG_EACH_5, BLOG_EACH_4, BLOG_EACH_3, \
+    BLOG_EACH_2, BLOG_EACH_1, BLOG_EACH_0)(r, ##__VA_ARGS__)
+
+#define BLOG(level, fmt, ...)                                 \
+  do {                                                        \
+    if (0) {                                                  \
+      printf(fmt, ##__VA_ARGS__);  /* format checking only */ \
+    }                                                         \
+    blog_rec_t _blog;                                         \
+    blog_begin(&_blog, level, TAG, fmt);                      \
+    BLOG_EACH(&_blog, ##__VA_ARGS__)                          \
+    blog_end(&_blog);                                         \
+  } while (0)
+
+#define BLOGE(fmt, ...) BLOG(BLOG_ERROR, fmt, ##__VA_ARGS__)
+#define BLOGW(fmt, ...) BLOG(BLOG_WARN, fmt, ##__VA_ARGS__)
+#define BLOGI(fmt, ...) BLOG(BLOG_INFO, fmt, ##__VA_ARGS__)
+
+void blog_init(void);
+void blog_begin(blog_rec_t *r, uint8_t level, const char *tag, const char *fmt);
+void blog_end(blog_rec_t *r);
+void blog_stats(uint32_t *records, uint32_t *dropped);
+void blog_bench(void);
 
 #endif // MAIN_H
@@ -1,3 +1,4 @@
+#include <sys/param.h>
 #include "esp_err.h"
 #include "mqtt_client.h"
 
@@ -5,34 +6,166 @@
 
 #define MQTT_CHANNEL "channel/0"
 
+// calls are published to MQTT_CHANNEL as <name>\0<MAC>/<SEQ>, so receivers can deduplicate them against the LAN
+// path while firmware that predates call ids still shows the name, which ends at the NUL. The subscription also
+// matches MQTT_CHANNEL/<MAC>/<SEQ>, where units of an earlier build put the id.
+#define MQTT_SUBSCRIBE MQTT_CHANNEL "/#"
+#define MQTT_ID_FMT "%02X%02X%02X%02X%02X%02X/%" PRIu32
+
+#define MQTT_RECONNECT_FALLBACK_MS (10 * 60 * 1000)
+
 esp_mqtt_client_handle_t mqtt;
 
 static const char *TAG = "MQTT";
 
-void mqtt_publish(void) {
+// payload being reassembled from MQTT_EVENT_DATA chunks; only touched from the MQTT task
+static char *rx_buf;
+static call_id_t rx_id;
+static bool rx_has_id;
+
+void mqtt_publish(uint32_t seq) {
   if (mqtt) {
-    esp_mqtt_client_publish(mqtt, MQTT_CHANNEL, name, strlen(name), 1, false);
-    ESP_LOGI(TAG, "Published to topic %s: %s", MQTT_CHANNEL, name);
+    device_state_t state;
+    state_get(&state);
+
+    char payload[64];
+    int len = strlen(state.name) + 1;
+    memcpy(payload, state.name, len);
+    len += snprintf(payload + len, sizeof(payload) - len, MQTT_ID_FMT, dev_mac[0], dev_mac[1], dev_mac[2], dev_mac[3],
+      dev_mac[4], dev_mac[5], seq);
+
+    esp_mqtt_client_publish(mqtt, MQTT_CHANNEL, payload, len, 1, false);
+    BLOGI("published seq %" PRIu32 ": %s", seq, state.name);
   } else {
     ESP_LOGW(TAG, "client not initialized");
     lcd_printf(LV_FONT(24), 10 * 1000, "MQTT\nnot initialized");
   }
 }
 
+// parses <MAC>/<SEQ> from the len bytes at s
+static bool mqtt_parse_id(const char *s, int len, call_id_t *id) {
+  char buf[32];
+  unsigned int m[6];
+
+  if (len <= 0 || len >= sizeof(buf)) {
+    return false;
+  }
+
+  memcpy(buf, s, len);
+  buf[len] = '\0';
+
+  if (sscanf(buf, "%2X%2X%2X%2X%2X%2X/%" SCNu32, &m[0], &m[1], &m[2], &m[3], &m[4], &m[5], &id->seq) != 7) {
+    return false;
+  }
+
+  for (int i = 0; i < 6; i++) {
+    id->mac[i] = m[i];
+  }
+
+  return true;
+}
+
+static void mqtt_data(esp_mqtt_event_handle_t event) {
+  int offset = event->current_data_offset;
+
+  // the topic is only present on the first chunk of a message
+  if (offset == 0) {
+    msgbuf_put(rx_buf);
+    rx_buf = msgbuf_get();
+
+    int prefix = strlen(MQTT_CHANNEL "/");
+    rx_has_id  = event->topic_len > prefix && !memcmp(event->topic, MQTT_CHANNEL "/", prefix) &&
+                mqtt_parse_id(event->topic + prefix, event->topic_len - prefix, &rx_id);
+
+    if (event->total_data_len >= MSGBUF_SIZE) {
+      msgbuf_truncated();
+    }
+  }
+
+  // no buffer was available for this message; drop the rest of it
+  if (!rx_buf) {
+    return;
+  }
+
+  if (offset < MSGBUF_SIZE - 1) {
+    int len = MIN(event->data_len, MSGBUF_SIZE - 1 - offset);
+    memcpy(rx_buf + offset, event->data, len);
+  }
+
+  if (offset + event->data_len >= event->total_data_len) {
+    int len     = MIN(event->total_data_len, MSGBUF_SIZE - 1);
+    rx_buf[len] = '\0';
+
+    // the id after the name; the buffer then reads as just the name
+    char *sep = memchr(rx_buf, '\0', len);
+
+    if (sep && mqtt_parse_id(sep + 1, rx_buf + len - sep - 1, &rx_id)) {
+      rx_has_id = true;
+    }
+
+    if (rx_has_id) {
+      BLOGI("call from %02X%02X%02X%02X%02X%02X seq %" PRIu32 ", %d bytes", rx_id.mac[0], rx_id.mac[1], rx_id.mac[2],
+        rx_id.mac[3], rx_id.mac[4], rx_id.mac[5], rx_id.seq, event->total_data_len);
+    } else {
+      BLOGI("call without id, %d bytes", event->total_data_len);
+    }
+
+    // a blank name would show as a call from nobody; name the sender by its MAC instead, or drop it
+    if (!rx_buf[0] && rx_has_id) {
+      snprintf(rx_buf, MSGBUF_SIZE, "%02X%02X%02X%02X%02X%02X", rx_id.mac[0], rx_id.mac[1], rx_id.mac[2],
+        rx_id.mac[3], rx_id.mac[4], rx_id.mac[5]);
+    } else if (!rx_buf[0]) {
+      BLOGW("dropped empty call");
+      msgbuf_put(rx_buf);
+      rx_buf = NULL;
+      return;
+    }
+
+    call_recv(rx_has_id ? &rx_id : NULL, CALL_MQTT, rx_buf);
+    rx_buf = NULL;
+  }
+}
+
+// set and cleared by the MQTT task
+static bool mqtt_connected;
+
+static void mqtt_retry(void) {
+  esp_mqtt_client_reconnect(mqtt);
+}
+
+// Wi-Fi is back; a broker connection that backed off while the network was gone tries again right away
+void mqtt_kick(void) {
+  if (!mqtt) {
+    return;
+  }
+
+  reconnect_reset(LINK_MQTT);
+
+  if (!mqtt_connected) {
+    ESP_LOGI(TAG, "network is back, reconnecting");
+    esp_mqtt_client_reconnect(mqtt);
+  }
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
   esp_mqtt_event_handle_t event = event_data;
 
   switch (event_id) {
     case MQTT_EVENT_CONNECTED:
-      esp_mqtt_client_subscribe(mqtt, MQTT_CHANNEL, 1);
+      esp_mqtt_client_subscribe(mqtt, MQTT_SUBSCRIBE, 1);
       ESP_LOGI(TAG, "connected");
+      mqtt_connected = true;
+      reconnect_up(LINK_MQTT);
+      api_event("status", "MQTT connected");
       break;
     case MQTT_EVENT_DISCONNECTED:
       ESP_LOGW(TAG, "disconnected");
+      mqtt_connected = false;
+      reconnect_down(LINK_MQTT, mqtt_retry);
+      api_event("status", "MQTT disconnected");
       break;
     case MQTT_EVENT_DATA:
-      ESP_LOGI( TAG, "data received on topic %.*s: %.*s", event->topic_len, event->topic, event->data_len, event->data);
-      lcd_printf(LV_FONT(30), 60 * 1000, "%.*s\ncalled everyone!", event->data_len, event->data);
+      mqtt_data(event);
       break;
     case MQTT_EVENT_ERROR:
       ESP_LOGW(TAG, "error %d", event->error_handle->error_type);
@@ -44,15 +177,32 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 }
 
 esp_err_t mqtt_init(void) {
+  device_state_t state;
+  state_get(&state);
+
   char mqtt_url[64];
-  snprintf(mqtt_url, sizeof(mqtt_url), "mqtt://%s", server);
+  snprintf(mqtt_url, sizeof(mqtt_url), "mqtt://%s", state.server);
 
   esp_mqtt_client_config_t mqtt_cfg = {
     .broker.address.uri = mqtt_url,
     .session.keepalive  = 10,
     .task.priority      = 5,
+    // retries are driven by reconnect_down(); the client's own timer is only a fallback
+    .network.reconnect_timeout_ms = MQTT_RECONNECT_FALLBACK_MS,
   };
 
+  if (ca_pem) {
+    snprintf(mqtt_url, sizeof(mqtt_url), "mqtts://%s:%d", state.server, MQTT_TLS_PORT);
+    mqtt_cfg.network.transport = tls_transport(ca_pem);
+
+    // without it the client would fall back to its own transport, which has no CA to check the broker against
+    if (!mqtt_cfg.network.transport) {
+      ESP_LOGE(TAG, "no memory for the TLS transport, MQTT not started");
+      lcd_printf(LV_FONT(24), 10 * 1000, "MQTT TLS failed");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
   mqtt = esp_mqtt_client_init(&mqtt_cfg);
 
   ESP_ERROR_CHECK(esp_mqtt_client_register_event(mqtt, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL));
@@ -0,0 +1,43 @@
+#include "main.h"
+
+#define MSGBUF_COUNT 8
+
+static char bufs[MSGBUF_COUNT][MSGBUF_SIZE];
+static QueueHandle_t free_bufs = NULL;
+
+static const char *TAG = "MSGBUF";
+
+msgbuf_stats_t msgbuf_stats;
+
+void msgbuf_init(void) {
+  free_bufs = xQueueCreate(MSGBUF_COUNT, sizeof(char *));
+
+  for (int i = 0; i < MSGBUF_COUNT; i++) {
+    char *buf = bufs[i];
+    xQueueSend(free_bufs, &buf, 0);
+  }
+}
+
+char *msgbuf_get(void) {
+  char *buf;
+
+  if (!xQueueReceive(free_bufs, &buf, 0)) {
+    __atomic_fetch_add(&msgbuf_stats.exhausted, 1, __ATOMIC_RELAXED);
+    ESP_LOGW(TAG, "pool exhausted");
+    return NULL;
+  }
+
+  buf[0] = '\0';
+  return buf;
+}
+
+void msgbuf_put(char *buf) {
+  if (buf) {
+    xQueueSend(free_bufs, &buf, 0);
+  }
+}
+
+void msgbuf_truncated(void) {
+  __atomic_fetch_add(&msgbuf_stats.truncated, 1, __ATOMIC_RELAXED);
+  ESP_LOGW(TAG, "message truncated to %d bytes", MSGBUF_SIZE - 1);
+}
@@ -1,12 +1,18 @@
 #include "esp_http_server.h"
 #include "lwip/sockets.h"
 
+#include "damppi_core.h"
 #include "main.h"
 
 esp_err_t root_get(httpd_req_t *req);
 esp_err_t save_post(httpd_req_t *req);
 esp_err_t reset_post(httpd_req_t *req);
 esp_err_t redirect_root(httpd_req_t *req);
+esp_err_t call_post(httpd_req_t *req);
+esp_err_t ws_get(httpd_req_t *req);
+esp_err_t stats_get(httpd_req_t *req);
+esp_err_t log_get(httpd_req_t *req);
+void api_init(httpd_handle_t httpd);
 
 static const char *TAG = "SRV";
 
@@ -31,6 +37,8 @@ void dns_server(void *arg) {
     return;
   }
 
+  static const uint8_t ap_ip[4] = { 192, 168, 4, 1 };
+
   uint8_t rx[512];
   uint8_t tx[512];
 
@@ -39,35 +47,12 @@ void dns_server(void *arg) {
     socklen_t fromlen       = sizeof(from);
     int len                 = recvfrom(sock, rx, sizeof(rx), 0, (struct sockaddr *)&from, &fromlen);
 
-    if (len < 12 || len > (sizeof(tx) - 16)) {
+    int p = dns_reply(rx, len, tx, sizeof(tx), ap_ip);
+
+    if (p < 0) {
       continue;
     }
 
-    memcpy(tx, rx, len);
-    tx[2] = 0x81;
-    tx[3] = 0x80;  // response, no error
-    tx[6] = 0x00;
-    tx[7] = 0x01;                            // ANCOUNT=1
-    tx[8] = tx[9] = tx[10] = tx[11] = 0x00;  // NS/AR=0
-
-    int p   = len;
-    tx[p++] = 0xC0;
-    tx[p++] = 0x0C;  // NAME ptr
-    tx[p++] = 0x00;
-    tx[p++] = 0x01;  // TYPE A
-    tx[p++] = 0x00;
-    tx[p++] = 0x01;  // CLASS IN
-    tx[p++] = 0x00;
-    tx[p++] = 0x00;
-    tx[p++] = 0x00;
-    tx[p++] = 0x3C;  // TTL
-    tx[p++] = 0x00;
-    tx[p++] = 0x04;  // RDLENGTH
-    tx[p++] = 192;
-    tx[p++] = 168;
-    tx[p++] = 4;
-    tx[p++] = 1;  // 192.168.4.1
-
     (void)sendto(sock, tx, p, 0, (struct sockaddr *)&from, fromlen);
   }
 }
@@ -76,7 +61,9 @@ void http_server(bool ap_mode) {
   httpd_handle_t httpd;
   httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
 
-  cfg.max_uri_handlers = 24;
+  cfg.max_uri_handlers  = 24;
+  cfg.lru_purge_enable  = true;
+  cfg.send_wait_timeout = 2;  // bounds how long a stalled websocket client can hold the httpd task
   ESP_ERROR_CHECK(httpd_start(&httpd, &cfg));
 
   httpd_uri_t u_root  = { .uri = "/", .method = HTTP_GET, .handler = root_get };
@@ -86,6 +73,18 @@ void http_server(bool ap_mode) {
   ESP_ERROR_CHECK(httpd_register_uri_handler(httpd, &u_save));
   ESP_ERROR_CHECK(httpd_register_uri_handler(httpd, &u_reset));
 
+  if (!ap_mode) {
+    httpd_uri_t u_call  = { .uri = "/api/call", .method = HTTP_POST, .handler = call_post };
+    httpd_uri_t u_stats = { .uri = "/api/stats", .method = HTTP_GET, .handler = stats_get };
+    httpd_uri_t u_ws    = { .uri = "/api/ws", .method = HTTP_GET, .handler = ws_get, .is_websocket = true };
+    httpd_uri_t u_log   = { .uri = "/api/log", .method = HTTP_GET, .handler = log_get };
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd, &u_call));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd, &u_stats));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd, &u_ws));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd, &u_log));
+    api_init(httpd);
+  }
+
   if (ap_mode) {
     static const char *captive_paths[] = {
       "/generate_204",
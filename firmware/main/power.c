@@ -0,0 +1,90 @@
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#include "main.h"
+
+#if CONFIG_DAMPPI_POWER_SAVER
+const char *const power_mode = "saver";
+#define POWER_LIGHT_SLEEP true
+#define POWER_WIFI_PS WIFI_PS_MAX_MODEM
+#define POWER_LISTEN_INTERVAL CONFIG_DAMPPI_POWER_LISTEN_INTERVAL
+#elif CONFIG_DAMPPI_POWER_BALANCED
+const char *const power_mode = "balanced";
+#define POWER_LIGHT_SLEEP true
+#define POWER_WIFI_PS WIFI_PS_MIN_MODEM
+#define POWER_LISTEN_INTERVAL 0
+#else
+const char *const power_mode = "performance";
+#define POWER_LIGHT_SLEEP false
+#define POWER_WIFI_PS WIFI_PS_NONE
+#define POWER_LISTEN_INTERVAL 0
+#endif
+
+static const char *TAG = "POWER";
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// light sleep residency, updated by the sleep callbacks from the idle task with interrupts disabled
+static power_stats_t stats;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+static int64_t sleep_start;
+
+static esp_err_t IRAM_ATTR power_sleep_enter(int64_t sleep_time_us, void *arg) {
+  sleep_start = esp_timer_get_time();
+  return ESP_OK;
+}
+
+static esp_err_t IRAM_ATTR power_sleep_exit(int64_t sleep_time_us, void *arg) {
+  stats.sleeps++;
+  stats.sleep_us += esp_timer_get_time() - sleep_start;
+  return ESP_OK;
+}
+#endif
+
+void power_init(void) {
+  // the CPU drops to the crystal clock whenever no PM lock asks for more, and sleeps when no task is ready
+  esp_pm_config_t pm = {
+    .max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+    .min_freq_mhz       = POWER_LIGHT_SLEEP ? CONFIG_XTAL_FREQ : CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+    .light_sleep_enable = POWER_LIGHT_SLEEP,
+  };
+
+  esp_err_t err = esp_pm_configure(&pm);
+
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "power management unavailable: %s", esp_err_to_name(err));
+    return;
+  }
+
+  // the buttons wake the chip by level, see gpio_follow() in main.c
+  ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+  esp_pm_sleep_cbs_register_config_t cbs = {
+    .enter_cb = power_sleep_enter,
+    .exit_cb  = power_sleep_exit,
+  };
+  ESP_ERROR_CHECK(esp_pm_light_sleep_register_cbs(&cbs));
+#endif
+
+  ESP_LOGI(TAG, "%s mode, CPU %d-%d MHz", power_mode, pm.min_freq_mhz, pm.max_freq_mhz);
+}
+
+// after esp_wifi_init; the radio sleeps between the beacons it listens to, and the AP buffers frames meanwhile
+void power_wifi(void) {
+  ESP_ERROR_CHECK(esp_wifi_set_ps(POWER_WIFI_PS));
+}
+
+void power_sta_config(wifi_sta_config_t *sta) {
+  sta->listen_interval = POWER_LISTEN_INTERVAL;
+}
+
+void power_stats(power_stats_t *out) {
+  // the callbacks cannot run while this task holds the only core
+  taskENTER_CRITICAL(&stats_lock);
+  *out = stats;
+  taskEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,104 @@
+#include "esp_event.h"
+#include "esp_timer.h"
+
+#include "damppi_core.h"
+#include "main.h"
+
+// a retry that could not be posted because the event queue was full is tried again this much later
+#define RECONNECT_REPOST_MS 100
+
+ESP_EVENT_DEFINE_BASE(RECONNECT_EVENT);
+
+typedef struct {
+  const char *name;
+  backoff_t backoff;
+  esp_timer_handle_t timer;
+  void (*retry)(void);
+} link_state_t;
+
+static const char *TAG = "RECONNECT";
+
+static portMUX_TYPE links_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static link_state_t links[LINK_COUNT] = {
+  [LINK_WIFI] = { .name = "Wi-Fi" },
+  [LINK_MQTT] = { .name = "MQTT" },
+};
+
+// the timer fires on the esp_timer task; the retry is posted to the default event loop so that it runs on the
+// same task as the Wi-Fi event handler and never races it over the scan results
+static void reconnect_timer(void *arg) {
+  link_state_t *l = arg;
+
+  if (esp_event_post(RECONNECT_EVENT, l - links, NULL, 0, 0) != ESP_OK) {
+    esp_timer_start_once(l->timer, RECONNECT_REPOST_MS * 1000);
+  }
+}
+
+static void reconnect_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+  links[id].retry();
+}
+
+void reconnect_init(void) {
+  for (int i = 0; i < LINK_COUNT; i++) {
+    links[i].backoff = (backoff_t){
+      .base_ms    = CONFIG_DAMPPI_RECONNECT_BASE_MS,
+      .max_ms     = CONFIG_DAMPPI_RECONNECT_MAX_MS,
+      .healthy_ms = CONFIG_DAMPPI_RECONNECT_HEALTHY_MS,
+    };
+    backoff_seed(&links[i].backoff, dev_mac, i);
+
+    esp_timer_create_args_t args = { .callback = reconnect_timer, .arg = &links[i], .name = "reconnect" };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &links[i].timer));
+  }
+
+  ESP_ERROR_CHECK(esp_event_handler_register(RECONNECT_EVENT, ESP_EVENT_ANY_ID, reconnect_event, NULL));
+}
+
+void reconnect_down(link_t link, void (*retry)(void)) {
+  link_state_t *l = &links[link];
+
+  taskENTER_CRITICAL(&links_lock);
+  int delay         = backoff_next(&l->backoff, esp_timer_get_time());
+  uint32_t attempts = l->backoff.attempts;
+  taskEXIT_CRITICAL(&links_lock);
+
+  ESP_LOGI(TAG, "%s retry %" PRIu32 " in %d ms", l->name, attempts, delay);
+
+  // a retry already pending is replaced, the link is down again anyway
+  esp_timer_stop(l->timer);
+  l->retry = retry;
+  esp_timer_start_once(l->timer, (uint64_t)delay * 1000);
+}
+
+void reconnect_up(link_t link) {
+  link_state_t *l = &links[link];
+
+  esp_timer_stop(l->timer);
+
+  taskENTER_CRITICAL(&links_lock);
+  backoff_up(&l->backoff, esp_timer_get_time());
+  taskEXIT_CRITICAL(&links_lock);
+}
+
+void reconnect_reset(link_t link) {
+  link_state_t *l = &links[link];
+
+  esp_timer_stop(l->timer);
+
+  taskENTER_CRITICAL(&links_lock);
+  l->backoff.attempt  = 0;
+  l->backoff.up_since = 0;
+  taskEXIT_CRITICAL(&links_lock);
+}
+
+void reconnect_stats(link_t link, reconnect_stats_t *out) {
+  taskENTER_CRITICAL(&links_lock);
+  *out = (reconnect_stats_t){
+    .attempts = links[link].backoff.attempts,
+    .connects = links[link].backoff.connects,
+    .resets   = links[link].backoff.resets,
+    .delay_ms = links[link].backoff.delay_ms,
+  };
+  taskEXIT_CRITICAL(&links_lock);
+}
@@ -0,0 +1,18 @@
+#include "damppi_core.h"
+#include "main.h"
+
+// published copies of the device state; see snap_t for how readers and writers avoid each other
+static snap_t snap;
+static uint8_t snap_buf[SNAP_BUF_SIZE(sizeof(device_state_t))] __attribute__((aligned(4)));
+
+void state_init(void) {
+  snap_init(&snap, snap_buf, sizeof(device_state_t), &(device_state_t){ 0 });
+}
+
+void state_get(device_state_t *out) {
+  snap_read(&snap, out);
+}
+
+void state_publish(const device_state_t *state) {
+  snap_publish(&snap, state);
+}
@@ -0,0 +1,191 @@
+#include <sys/param.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "esp_transport.h"
+#include "lwip/sockets.h"
+#include "mbedtls/ssl.h"
+
+#include "main.h"
+
+// esp-mqtt's own SSL transport does not keep the TLS session between reconnects, so this one wraps esp-tls
+// directly and offers the last session ticket on every reconnect to skip the full handshake
+typedef struct {
+  const char *ca;
+  esp_tls_t *tls;
+  esp_tls_client_session_t *session;
+} tls_ctx_t;
+
+static const char *TAG = "TLS";
+
+tls_stats_t tls_stats;
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms) {
+  tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+  esp_tls_cfg_t cfg = {
+    .cacert_pem_buf   = (const unsigned char *)ctx->ca,
+    .cacert_pem_bytes = strlen(ctx->ca) + 1,
+    .timeout_ms       = timeout_ms,
+    .client_session   = ctx->session,
+  };
+
+  ctx->tls = esp_tls_init();
+
+  if (!ctx->tls) {
+    return -1;
+  }
+
+  size_t heap   = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+  int64_t start = esp_timer_get_time();
+
+  heap_caps_monitor_local_minimum_free_size_start();
+  int ret         = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, ctx->tls);
+  size_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+  heap_caps_monitor_local_minimum_free_size_stop();
+
+  int64_t elapsed = esp_timer_get_time() - start;
+
+  if (ret != 1) {
+    ESP_LOGW(TAG, "handshake with %s:%d failed", host, port);
+    esp_tls_conn_destroy(ctx->tls);
+    ctx->tls = NULL;
+
+    // the broker may have dropped the ticket; fall back to a full handshake next time
+    if (ctx->session) {
+      esp_tls_free_client_session(ctx->session);
+      ctx->session = NULL;
+    }
+
+    return -1;
+  }
+
+  // the broker may ignore the offered ticket and run a full handshake, so only the outcome tells
+  bool resume = mbedtls_ssl_session_reused(esp_tls_get_ssl_context(ctx->tls));
+
+  tls_handshake_t *hs = resume ? &tls_stats.resumed : &tls_stats.full;
+  hs->count++;
+  hs->last_us   = elapsed;
+  hs->heap_peak = MAX(hs->heap_peak, heap - heap_min);
+
+  ESP_LOGI(TAG, "%s handshake in %lld ms, heap peak %u bytes", resume ? "resumed" : "full", elapsed / 1000,
+    (unsigned)(heap - heap_min));
+
+  if (ctx->session) {
+    esp_tls_free_client_session(ctx->session);
+  }
+
+  ctx->session = esp_tls_get_client_session(ctx->tls);
+
+  return 0;
+}
+
+static int tls_poll(esp_transport_handle_t t, int timeout_ms, bool write) {
+  tls_ctx_t *ctx = esp_transport_get_context_data(t);
+  int fd;
+
+  if (!ctx->tls || esp_tls_get_conn_sockfd(ctx->tls, &fd) != ESP_OK) {
+    return -1;
+  }
+
+  // records already decrypted by mbedTLS won't show up on the socket
+  if (!write && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+    return 1;
+  }
+
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(fd, &fds);
+
+  struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+
+  return select(fd + 1, write ? NULL : &fds, write ? &fds : NULL, NULL, timeout_ms < 0 ? NULL : &tv);
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms) {
+  return tls_poll(t, timeout_ms, false);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms) {
+  return tls_poll(t, timeout_ms, true);
+}
+
+static int tls_read(esp_transport_handle_t t, char *buf, int len, int timeout_ms) {
+  tls_ctx_t *ctx = esp_transport_get_context_data(t);
+  int ready      = tls_poll_read(t, timeout_ms);
+
+  if (ready <= 0) {
+    return ready == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+  }
+
+  int ret = esp_tls_conn_read(ctx->tls, buf, len);
+
+  if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+    return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+  }
+
+  if (ret == 0) {
+    return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+  }
+
+  return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buf, int len, int timeout_ms) {
+  tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+  if (tls_poll_write(t, timeout_ms) <= 0) {
+    return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+  }
+
+  int ret = esp_tls_conn_write(ctx->tls, buf, len);
+
+  return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ret;
+}
+
+static int tls_close(esp_transport_handle_t t) {
+  tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+  if (ctx->tls) {
+    esp_tls_conn_destroy(ctx->tls);
+    ctx->tls = NULL;
+  }
+
+  return 0;
+}
+
+static int tls_destroy(esp_transport_handle_t t) {
+  tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+  tls_close(t);
+
+  if (ctx->session) {
+    esp_tls_free_client_session(ctx->session);
+  }
+
+  free(ctx);
+  return 0;
+}
+
+esp_transport_handle_t tls_transport(const char *ca) {
+  tls_ctx_t *ctx           = calloc(1, sizeof(tls_ctx_t));
+  esp_transport_handle_t t = esp_transport_init();
+
+  if (!ctx || !t) {
+    free(ctx);
+
+    if (t) {
+      esp_transport_destroy(t);
+    }
+
+    return NULL;
+  }
+
+  ctx->ca = ca;
+
+  esp_transport_set_context_data(t, ctx);
+  esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close, tls_poll_read, tls_poll_write, tls_destroy);
+  esp_transport_set_default_port(t, MQTT_TLS_PORT);
+
+  return t;
+}
@@ -1,18 +1,27 @@
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "lwip/ip4_addr.h"
 
+#include "damppi_core.h"
 #include "main.h"
 
+#define WIFI_SCAN_MAX 16
+#define WIFI_SCAN_TTL_MS (30 * 1000)
+#define WIFI_RESCAN_MS (10 * 1000)
+#define WIFI_RSSI_LOW -75
+
 esp_err_t mqtt_init(void);
+void mqtt_kick(void);
+esp_err_t lan_init(void);
 void dns_server(void *arg);
 void http_server(bool ap_mode);
+void power_wifi(void);
+void power_sta_config(wifi_sta_config_t *sta);
 
 static const char *TAG = "NET";
 
 static EventGroupHandle_t s_wifi_ev = NULL;
 
-char status[128];
-
 void wifi_softap(void) {
   ESP_ERROR_CHECK(esp_netif_init());
   ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -36,7 +45,10 @@ void wifi_softap(void) {
     },
   };
 
-  snprintf((char *)wifi.ap.ssid, sizeof(wifi.ap.ssid), "%s", hostname);
+  device_state_t state;
+  state_get(&state);
+
+  snprintf((char *)wifi.ap.ssid, sizeof(wifi.ap.ssid), "%s", state.hostname);
 
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
   ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi));
@@ -49,52 +61,218 @@ void wifi_softap(void) {
   http_server(true);
 }
 
+static roam_ap_t scan[WIFI_SCAN_MAX];
+static int scan_count;
+static int64_t scan_time;
+
+static bool connected;
+static bool roaming;
+static int64_t gap_start;  // start of the current connection gap, for the roam gap measurement
+static char cur_ssid[33];
+static uint8_t lost_bssid[6];
+
+static esp_timer_handle_t rssi_timer;
+
+static void wifi_scan(void) {
+  // a scan is already running if this fails, its SCAN_DONE is handled the same way
+  esp_wifi_scan_start(NULL, false);
+}
+
+static void wifi_rssi_timer(void *arg) {
+  esp_wifi_set_rssi_threshold(WIFI_RSSI_LOW);
+}
+
+static void wifi_scan_done(void) {
+  static wifi_ap_record_t records[WIFI_SCAN_MAX];
+  uint16_t count = WIFI_SCAN_MAX;
+
+  if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+    count = 0;
+  }
+
+  for (int i = 0; i < count; i++) {
+    snprintf(scan[i].ssid, sizeof(scan[i].ssid), "%s", (char *)records[i].ssid);
+    memcpy(scan[i].bssid, records[i].bssid, sizeof(scan[i].bssid));
+    scan[i].channel = records[i].primary;
+    scan[i].rssi    = records[i].rssi;
+  }
+
+  scan_count = count;
+  scan_time  = esp_timer_get_time();
+}
+
+static int wifi_pick(const uint8_t *avoid) {
+  const char *saved[WIFI_NETS];
+
+  for (int i = 0; i < WIFI_NETS; i++) {
+    saved[i] = nets[i].ssid;
+  }
+
+  return roam_pick(scan, scan_count, saved, WIFI_NETS, avoid);
+}
+
+static bool wifi_connect_best(const uint8_t *avoid) {
+  int best = wifi_pick(avoid);
+
+  if (best < 0) {
+    return false;
+  }
+
+  const roam_ap_t *ap = &scan[best];
+  const char *pass    = "";
+
+  for (int i = 0; i < WIFI_NETS; i++) {
+    if (!strcmp(nets[i].ssid, ap->ssid)) {
+      pass = nets[i].pass;
+      break;
+    }
+  }
+
+  wifi_config_t wifi = { 0 };
+  snprintf((char *)wifi.sta.ssid, sizeof(wifi.sta.ssid), "%s", ap->ssid);
+  snprintf((char *)wifi.sta.password, sizeof(wifi.sta.password), "%s", pass);
+  memcpy(wifi.sta.bssid, ap->bssid, sizeof(wifi.sta.bssid));
+  wifi.sta.bssid_set          = true;
+  wifi.sta.channel            = ap->channel;
+  wifi.sta.scan_method        = WIFI_FAST_SCAN;
+  wifi.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+  wifi.sta.rm_enabled         = true;  // 802.11k neighbor reports
+  wifi.sta.btm_enabled        = true;  // 802.11v AP steered roaming
+  power_sta_config(&wifi.sta);
+
+  ESP_LOGI(TAG, "connecting to %s " MACSTR " ch %d, rssi %d", ap->ssid, MAC2STR(ap->bssid), ap->channel, ap->rssi);
+
+  esp_wifi_set_config(WIFI_IF_STA, &wifi);
+  esp_wifi_connect();
+
+  return true;
+}
+
+// connects from cached scan results while they are fresh, otherwise rescans first
+static void wifi_reconnect(const uint8_t *avoid) {
+  if (esp_timer_get_time() - scan_time < WIFI_SCAN_TTL_MS * 1000 &&
+      (wifi_connect_best(avoid) || wifi_connect_best(NULL))) {
+    return;
+  }
+
+  wifi_scan();
+}
+
+static void wifi_retry(void) {
+  wifi_reconnect(lost_bssid);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
   if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) {
-    esp_wifi_connect();
+    gap_start = esp_timer_get_time();
+    wifi_scan();
+  } else if (base == WIFI_EVENT && id == WIFI_EVENT_SCAN_DONE) {
+    wifi_scan_done();
+
+    if (!connected) {
+      if (!wifi_connect_best(NULL)) {
+        ESP_LOGW(TAG, "no saved network in range");
+        reconnect_down(LINK_WIFI, wifi_scan);
+      }
+
+      return;
+    }
+
+    // roam scan triggered by a weak signal; move only for a clearly better AP
+    int rssi;
+    wifi_ap_record_t cur;
+    int best = wifi_pick(NULL);
+
+    if (best >= 0 && esp_wifi_sta_get_ap_info(&cur) == ESP_OK && esp_wifi_sta_get_rssi(&rssi) == ESP_OK &&
+        memcmp(scan[best].bssid, cur.bssid, sizeof(cur.bssid)) && scan[best].rssi > rssi + ROAM_HYSTERESIS_DB) {
+      ESP_LOGI(TAG, "roaming from rssi %d to %s rssi %d", rssi, scan[best].ssid, scan[best].rssi);
+      roaming = true;
+      esp_wifi_disconnect();
+    } else {
+      esp_timer_start_once(rssi_timer, WIFI_RESCAN_MS * 1000);
+    }
+  } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_BSS_RSSI_LOW) {
+    wifi_event_bss_rssi_low_t *low = (wifi_event_bss_rssi_low_t *)data;
+    ESP_LOGI(TAG, "weak signal, rssi=%" PRIi32 ", scanning", low->rssi);
+    wifi_scan();
+  } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED) {
+    wifi_event_sta_connected_t *conn = (wifi_event_sta_connected_t *)data;
+    snprintf(cur_ssid, sizeof(cur_ssid), "%.*s", conn->ssid_len, (char *)conn->ssid);
+    connected = true;
+    esp_wifi_set_rssi_threshold(WIFI_RSSI_LOW);
   } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
     wifi_event_sta_disconnected_t *disc = (wifi_event_sta_disconnected_t *)data;
     ESP_LOGW(TAG, "STA disconnected, reason=%d", disc->reason);
-    esp_wifi_connect();
+
+    if (!gap_start) {
+      gap_start = esp_timer_get_time();
+    }
+
+    connected = false;
+
+    // after a deliberate roam the cache already holds the better AP; otherwise steer away from the lost one,
+    // backing off so that a fleet losing the same AP does not come back in lockstep
+    if (roaming) {
+      wifi_reconnect(NULL);
+    } else {
+      memcpy(lost_bssid, disc->bssid, sizeof(lost_bssid));
+      reconnect_down(LINK_WIFI, wifi_retry);
+    }
+
+    roaming = false;
   } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+    ip_event_got_ip_t *got = (ip_event_got_ip_t *)data;
+
+    ESP_LOGI(TAG, "STA IP: " IPSTR ", connection gap %lld ms", IP2STR(&got->ip_info.ip),
+      (esp_timer_get_time() - gap_start) / 1000);
+    gap_start = 0;
+    reconnect_up(LINK_WIFI);
+    mqtt_kick();
+
+    device_state_t state;
+    state_get(&state);
+    snprintf(state.ssid, sizeof(state.ssid), "%s", cur_ssid);
+    snprintf(state.status, sizeof(state.status), "Wi-Fi: %s\nSERVER: %s\nIP: " IPSTR "\n%s", cur_ssid, state.server,
+      IP2STR(&got->ip_info.ip), state.name);
+    state_publish(&state);
+
+    api_event("status", state.status);
     xEventGroupSetBits(s_wifi_ev, BIT0);
   }
 }
 
-void wifi_sta(const char *ssid, const char *pass) {
+void wifi_sta(void) {
   ESP_ERROR_CHECK(esp_netif_init());
   ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-  esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
+  esp_netif_create_default_wifi_sta();
   ESP_ERROR_CHECK(esp_wifi_init(&(wifi_init_config_t)WIFI_INIT_CONFIG_DEFAULT()));
 
   esp_netif_t *sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-  ESP_ERROR_CHECK(esp_netif_set_hostname(sta, hostname));
-
-  wifi_config_t wifi = { 0 };
-  snprintf((char *)wifi.sta.ssid, sizeof(wifi.sta.ssid), "%s", ssid);
-  snprintf((char *)wifi.sta.password, sizeof(wifi.sta.password), "%s", pass);
-  wifi.sta.scan_method        = WIFI_ALL_CHANNEL_SCAN;
-  wifi.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+  device_state_t state;
+  state_get(&state);
+  ESP_ERROR_CHECK(esp_netif_set_hostname(sta, state.hostname));
 
   s_wifi_ev = xEventGroupCreate();
 
+  esp_timer_create_args_t rssi_args = { .callback = wifi_rssi_timer, .name = "wifi_rssi" };
+  ESP_ERROR_CHECK(esp_timer_create(&rssi_args, &rssi_timer));
+  reconnect_init();
+
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi));
+  power_wifi();
   ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
   ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
   ESP_ERROR_CHECK(esp_wifi_start());
 
   xEventGroupWaitBits(s_wifi_ev, BIT0, false, true, portMAX_DELAY);
 
-  esp_netif_ip_info_t ip;
-
-  if (esp_netif_get_ip_info(sta_netif, &ip) == ESP_OK) {
-    ESP_LOGI(TAG, "STA IP: " IPSTR, IP2STR(&ip.ip));
-    snprintf(status, sizeof(status), "Wi-Fi: %s\nSERVER: %s\nIP: " IPSTR "\n%s", ssid, server, IP2STR(&ip.ip), name);
-    lcd_printf(LV_FONT(24), 5 * 1000, "%s", status);
-  }
+  state_get(&state);
+  lcd_printf(LV_FONT(24), 5 * 1000, "%s", state.status);
 
   http_server(false);
+#if CONFIG_DAMPPI_LAN
+  lan_init();
+#endif
   mqtt_init();
 }
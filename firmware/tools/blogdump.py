@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Decode a pager's binary log.
+
+The pager stores only the addresses of the tag and format strings plus the
+raw arguments (see BLOG in main/main.h). This fetches GET /api/log or reads a
+saved dump and formats the records with the strings from the firmware ELF,
+which must be the build running on the pager:
+
+    python tools/blogdump.py --device 192.168.0.11 --save pager.blog
+    python tools/blogdump.py --file pager.blog --elf build/damppi.elf
+
+Only the standard library is used.
+"""
+
+import argparse
+import hashlib
+import re
+import struct
+import sys
+import urllib.request
+
+FILE_HDR = struct.Struct("<4s32sII")
+REC_HDR = struct.Struct("<HBBIII")
+
+SPEC = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|z|j|t)?([diouxXcspfeEgG%])")
+
+
+class Elf:
+    """Loadable sections of a 32-bit little-endian ELF, to read strings by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            sys.exit(f"{path}: not a 32-bit ELF")
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+        self.sections = []
+
+        for i in range(shnum):
+            _, kind, flags, addr, offset, size = struct.unpack_from("<IIIIII", self.data, shoff + i * shentsize)
+
+            # SHT_PROGBITS with SHF_ALLOC
+            if kind == 1 and flags & 2 and addr:
+                self.sections.append((addr, offset, size))
+
+    def sha256(self):
+        return hashlib.sha256(self.data).digest()
+
+    def string(self, addr):
+        for base, offset, size in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.index(b"\0", start)
+                return self.data[start:end].decode(errors="replace")
+
+        return f"<unknown string 0x{addr:08x}>"
+
+
+class Args:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        size = struct.calcsize(fmt)
+
+        if self.pos + size > len(self.data):
+            return None
+
+        value, = struct.unpack_from(fmt, self.data, self.pos)
+        self.pos += size
+        return value
+
+    def string(self):
+        if self.pos >= len(self.data):
+            return None
+
+        length = self.data[self.pos]
+        value = self.data[self.pos + 1:self.pos + 1 + length].decode(errors="replace")
+        self.pos += 1 + length
+        return value
+
+
+def render(fmt, args):
+    """printf with the arguments read back in the order and sizes the pager wrote them."""
+
+    def conv(m):
+        flags, width, prec, length, kind = m.groups()
+
+        if kind == "%":
+            return "%"
+
+        if width == "*":
+            width = str(args.take("<i") or 0)
+
+        if prec == "*":
+            prec = str(args.take("<i") or 0)
+
+        wide = length == "ll"
+
+        if kind in "di":
+            value = args.take("<q" if wide else "<i")
+        elif kind in "ouxXc":
+            value = args.take("<Q" if wide else "<I")
+        elif kind == "p":
+            value, kind = args.take("<I"), "x"
+            flags, width = "0", "8"
+        elif kind == "s":
+            value = args.string()
+        else:
+            value = args.take("<d")
+
+        if value is None:
+            return "<missing>"
+
+        spec = "%" + flags + (width or "") + ("." + prec if prec else "") + ("d" if kind == "u" else kind)
+        return spec % value
+
+    return SPEC.sub(conv, fmt)
+
+
+def records(data):
+    pos = 0
+
+    while pos + REC_HDR.size <= len(data):
+        size, level, truncated, tag, fmt, ms = REC_HDR.unpack_from(data, pos)
+
+        if size < REC_HDR.size or pos + size > len(data):
+            sys.exit(f"corrupt record at offset {pos}")
+
+        yield chr(level), truncated, tag, fmt, ms, data[pos + REC_HDR.size:pos + size]
+        pos += size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--device", help="pager address to download /api/log from")
+    source.add_argument("--file", help="saved dump")
+    parser.add_argument("--elf", default="build/damppi.elf", help="firmware ELF running on the pager")
+    parser.add_argument("--save", help="also write the downloaded dump here")
+    args = parser.parse_args()
+
+    if args.device:
+        with urllib.request.urlopen(f"http://{args.device}/api/log", timeout=10) as r:
+            data = r.read()
+    else:
+        with open(args.file, "rb") as f:
+            data = f.read()
+
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(data)
+
+    magic, sha, total, dropped = FILE_HDR.unpack_from(data)
+
+    if magic != b"DLOG":
+        sys.exit("not a pager log")
+
+    elf = Elf(args.elf)
+
+    if elf.sha256() != sha:
+        print(f"warning: {args.elf} is not the firmware that wrote this log, strings may be wrong", file=sys.stderr)
+
+    print(f"# {total} records logged, {dropped} overwritten", file=sys.stderr)
+
+    for level, truncated, tag, fmt, ms, raw in records(data[FILE_HDR.size:]):
+        line = render(elf.string(fmt), Args(raw))
+        print(f"{level} ({ms}) {elf.string(tag)}: {line}{' <truncated>' if truncated else ''}")
+
+
+if __name__ == "__main__":
+    main()
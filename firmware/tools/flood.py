@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Flood a broker with calls and report how the pagers held up.
+
+Publishes calls from fake senders straight to the broker and/or hammers a
+pager's POST /api/call, then prints the pager's /api/stats deltas:
+
+    python tools/flood.py --broker 127.0.0.1 --senders 4 --rate 20 --seconds 30 --device 192.168.0.11
+    python tools/flood.py --press 192.168.0.10 --rate 10 --seconds 20 --device 192.168.0.11
+
+Only the standard library is used.
+"""
+
+import argparse
+import json
+import os
+import socket
+import struct
+import time
+import urllib.error
+import urllib.request
+
+CHANNEL = "channel/0"
+
+
+def mqtt_string(s):
+    b = s.encode()
+    return struct.pack(">H", len(b)) + b
+
+
+def mqtt_packet(kind, body):
+    length = len(body)
+    encoded = bytearray()
+
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | (0x80 if length else 0))
+        if not length:
+            break
+
+    return bytes([kind]) + bytes(encoded) + body
+
+
+def mqtt_connect(host, port):
+    sock = socket.create_connection((host, port), timeout=10)
+    client_id = "flood-" + os.urandom(4).hex()
+    body = mqtt_string("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 60) + mqtt_string(client_id)
+    sock.sendall(mqtt_packet(0x10, body))
+
+    ack = sock.recv(4)
+    if len(ack) < 4 or ack[0] != 0x20 or ack[3] != 0:
+        raise ConnectionError("broker refused connection")
+
+    return sock
+
+
+def stats(device):
+    with urllib.request.urlopen(f"http://{device}/api/stats", timeout=5) as resp:
+        return json.load(resp)
+
+
+def delta(before, after):
+    if isinstance(after, dict):
+        return {k: delta(before.get(k, 0), v) for k, v in after.items()}
+    return after - before
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--broker", help="publish fake calls to this broker")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--senders", type=int, default=1, help="distinct fake sender MACs")
+    ap.add_argument("--press", help="POST /api/call to this pager instead of/as well as the broker")
+    ap.add_argument("--rate", type=float, default=10, help="calls per second")
+    ap.add_argument("--seconds", type=float, default=10)
+    ap.add_argument("--device", help="pager whose /api/stats is compared before and after")
+    args = ap.parse_args()
+
+    if not args.broker and not args.press:
+        ap.error("nothing to flood, give --broker and/or --press")
+
+    before = stats(args.device) if args.device else None
+    sock = mqtt_connect(args.broker, args.port) if args.broker else None
+    macs = [os.urandom(6).hex().upper() for _ in range(args.senders)]
+
+    published = pressed = limited = 0
+    seq = 0
+    end = time.monotonic() + args.seconds
+    next_at = time.monotonic()
+
+    while time.monotonic() < end:
+        if sock:
+            mac = macs[seq % len(macs)]
+            payload = f"flood {mac[-4:]}\0{mac}/{seq}".encode()
+            sock.sendall(mqtt_packet(0x30, mqtt_string(CHANNEL) + payload))
+            published += 1
+
+        if args.press:
+            try:
+                urllib.request.urlopen(urllib.request.Request(f"http://{args.press}/api/call", method="POST"), timeout=5)
+                pressed += 1
+            except urllib.error.HTTPError as e:
+                if e.code != 429:
+                    raise
+                limited += 1
+
+        seq += 1
+        next_at += 1 / args.rate
+        time.sleep(max(0, next_at - time.monotonic()))
+
+    if sock:
+        sock.sendall(mqtt_packet(0xE0, b""))
+        sock.close()
+
+    result = {"published": published, "pressed": pressed, "press_limited": limited}
+
+    if args.device:
+        time.sleep(1)
+        result["device"] = delta(before, stats(args.device))
+
+    print(json.dumps(result))
+
+
+if __name__ == "__main__":
+    main()
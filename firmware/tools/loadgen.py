@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Measure HTTP-to-remote-display latency between two pagers.
+
+Sends calls with POST /api/call to the sender and times how long each takes
+to show up as a "call" event on the receiver's /api/ws stream:
+
+    python tools/loadgen.py 192.168.0.10 192.168.0.11 -n 50
+
+Both pagers must be on the same broker/subnet; only the standard library is used.
+The receiver's power mode and the share of the run it spent in light sleep
+are reported too, to compare the CONFIG_DAMPPI_POWER modes.
+
+Calls are paced to the limits both pagers report in /api/stats: no faster than
+the sender regains a token, and far enough apart that the receiver does not
+coalesce them. With a shorter -i, calls the sender refuses with 429 are
+counted as throttled, and calls the receiver coalesced as coalesced; only the
+rest count as lost.
+"""
+
+import argparse
+import base64
+import json
+import os
+import socket
+import statistics
+import struct
+import threading
+import time
+import urllib.error
+import urllib.request
+
+# Kconfig defaults, for firmware that does not report its limits
+REFILL_MS = 10000
+COALESCE_MS = 5000
+
+
+def ws_connect(host, path="/api/ws"):
+    sock = socket.create_connection((host, 80), timeout=10)
+    key = base64.b64encode(os.urandom(16)).decode()
+    sock.sendall(
+        f"GET {path} HTTP/1.1\r\nHost: {host}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n".encode()
+    )
+
+    resp = b""
+    while b"\r\n\r\n" not in resp:
+        chunk = sock.recv(1024)
+        if not chunk:
+            raise ConnectionError("websocket handshake failed")
+        resp += chunk
+
+    if b" 101 " not in resp.split(b"\r\n", 1)[0]:
+        raise ConnectionError(resp.decode(errors="replace"))
+
+    sock.settimeout(None)
+    return sock
+
+
+def recv_exact(sock, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise ConnectionError("websocket closed")
+        buf += chunk
+    return buf
+
+
+def ws_frames(sock):
+    """Yields text payloads of unmasked server frames."""
+    while True:
+        b0, b1 = recv_exact(sock, 2)
+        length = b1 & 0x7F
+        if length == 126:
+            length = struct.unpack(">H", recv_exact(sock, 2))[0]
+        elif length == 127:
+            length = struct.unpack(">Q", recv_exact(sock, 8))[0]
+        payload = recv_exact(sock, length)
+        if b0 & 0x0F == 0x1:
+            yield payload.decode(errors="replace")
+
+
+def stats(host):
+    with urllib.request.urlopen(f"http://{host}/api/stats", timeout=5) as r:
+        return json.load(r)
+
+
+def pace(sender, receiver):
+    """Seconds between calls that neither the sender's rate limit nor the receiver's coalescing gets in the way of."""
+    refill = sender["call"].get("refill_ms", REFILL_MS)
+    coalesce = receiver["call"].get("coalesce_ms", COALESCE_MS)
+    return max(refill, coalesce) / 1000 + 0.5
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("sender", help="pager that receives POST /api/call")
+    ap.add_argument("receiver", help="pager whose websocket stream is watched")
+    ap.add_argument("-n", "--count", type=int, default=20)
+    ap.add_argument("-i", "--interval", type=float, help="seconds between calls; by default paced to the limits")
+    ap.add_argument("-t", "--timeout", type=float, default=5.0)
+    args = ap.parse_args()
+
+    arrived = threading.Event()
+    ws = ws_connect(args.receiver)
+
+    def reader():
+        for text in ws_frames(ws):
+            if json.loads(text).get("type") == "call":
+                arrived.set()
+
+    threading.Thread(target=reader, daemon=True).start()
+
+    latencies = []
+    lost = throttled = coalesced = 0
+    before = stats(args.receiver)
+    interval = args.interval if args.interval is not None else pace(stats(args.sender), before)
+    seen_coalesced = before["call"]["coalesced"]
+
+    for i in range(args.count):
+        arrived.clear()
+        start = time.monotonic()
+
+        try:
+            urllib.request.urlopen(urllib.request.Request(f"http://{args.sender}/api/call", method="POST"), timeout=5)
+        except urllib.error.HTTPError as e:
+            if e.code != 429:
+                raise
+            throttled += 1
+            time.sleep(interval)
+            continue
+
+        if arrived.wait(args.timeout):
+            latencies.append((time.monotonic() - start) * 1000)
+        else:
+            # a coalesced call is received but never shown, so it has no event
+            now_coalesced = stats(args.receiver)["call"]["coalesced"]
+
+            if now_coalesced > seen_coalesced:
+                coalesced += 1
+            else:
+                lost += 1
+
+            seen_coalesced = now_coalesced
+
+        time.sleep(interval)
+
+    result = {"sent": args.count, "interval_s": interval, "received": len(latencies), "throttled": throttled,
+              "coalesced": coalesced, "lost": lost}
+    after = stats(args.receiver)
+
+    before, after = before.get("power"), after.get("power")
+
+    if before and after and after["uptime_ms"] > before["uptime_ms"]:
+        result.update(
+            power_mode=after["mode"],
+            light_sleep_pct=round(
+                100 * (after["sleep_ms"] - before["sleep_ms"]) / (after["uptime_ms"] - before["uptime_ms"]), 1),
+        )
+
+    if latencies:
+        latencies.sort()
+        result.update(
+            min_ms=round(latencies[0], 1),
+            median_ms=round(statistics.median(latencies), 1),
+            p95_ms=round(latencies[int(0.95 * (len(latencies) - 1))], 1),
+            max_ms=round(latencies[-1], 1),
+        )
+
+    print(json.dumps(result))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Build the glyph store image for the `font` partition.
+
+    pip install pillow
+    python tools/mkfont.py NotoSansKR-Regular.ttf -o font.bin
+
+The image is flashed together with the firmware when it exists at
+firmware/font.bin. See fontstore.c in components/damppi_core for the format.
+"""
+
+import argparse
+import struct
+import sys
+
+from PIL import Image, ImageDraw, ImageFont
+
+MAGIC = b"DMPF"
+VERSION = 1
+PARTITION_SIZE = 6 * 1024 * 1024
+
+RANGES = {
+    "hangul": [(0xAC00, 0xD7A3), (0x3131, 0x318E)],
+    "cjk": [(0x4E00, 0x9FFF)],
+    "kana": [(0x3041, 0x3096), (0x30A1, 0x30FA)],
+}
+
+
+def rle(pixels):
+    """value[4] | run - 1[4] per byte, see glyph_rle_decode()."""
+    out = bytearray()
+    i = 0
+
+    while i < len(pixels):
+        v = pixels[i]
+        run = 1
+
+        while run < 16 and i + run < len(pixels) and pixels[i + run] == v:
+            run += 1
+
+        out.append(v << 4 | (run - 1))
+        i += run
+
+    return bytes(out)
+
+
+def render(font, cp):
+    ch = chr(cp)
+    l, t, r, b = font.getbbox(ch, anchor="ls")
+    adv = round(font.getlength(ch))
+    w, h = r - l, b - t
+
+    if w <= 0 or h <= 0:
+        return adv, 0, 0, 0, 0, b""
+
+    if w > 255 or h > 255:
+        raise ValueError(f"U+{cp:04X} too large")
+
+    img = Image.new("L", (w, h), 0)
+    ImageDraw.Draw(img).text((-l, -t), ch, font=font, fill=255, anchor="ls")
+    pixels = [p >> 4 for p in img.getdata()]
+
+    # LVGL measures ofs_y upwards from the baseline to the bottom of the box
+    return adv, w, h, l, -b, rle(pixels)
+
+
+def build(path, sizes, ranges):
+    fonts = []
+
+    for size in sizes:
+        font = ImageFont.truetype(path, size)
+        ascent, descent = font.getmetrics()
+        notdef = font.getmask("\U0010FFFF").tobytes()
+        glyphs = []
+
+        for lo, hi in ranges:
+            for cp in range(lo, hi + 1):
+                # skip codepoints the font lacks instead of storing its .notdef box
+                if font.getmask(chr(cp)).tobytes() == notdef:
+                    continue
+
+                glyphs.append((cp,) + render(font, cp))
+
+        glyphs.sort()
+        fonts.append((size, ascent + descent, descent, glyphs))
+
+    header = struct.pack("<4sHH", MAGIC, VERSION, len(fonts))
+    offset = len(header) + 12 * len(fonts)
+    index_offsets = []
+
+    for _, _, _, glyphs in fonts:
+        index_offsets.append(offset)
+        offset += 16 * len(glyphs)
+
+    out = bytearray(header)
+    data = bytearray()
+
+    for (size, line_height, base_line, glyphs), index in zip(fonts, index_offsets):
+        out += struct.pack("<BBbBII", size, line_height, base_line, 4, len(glyphs), index)
+
+    for _, _, _, glyphs in fonts:
+        for cp, adv, w, h, ofs_x, ofs_y, bitmap in glyphs:
+            out += struct.pack("<IIHBBbbBx", cp, offset + len(data), len(bitmap), w, h, ofs_x, ofs_y, min(adv, 255))
+            data += bitmap
+
+    return bytes(out + data), fonts
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("font", help="TrueType/OpenType font with the required glyphs")
+    ap.add_argument("-o", "--output", default="font.bin")
+    ap.add_argument("-s", "--sizes", default="24,30", help="pixel sizes, by default those of LV_FONT() in main.h; "
+                    "sizes without their own glyphs are drawn with the closest one")
+    ap.add_argument("-r", "--ranges", default="hangul", help=f"comma separated, from {', '.join(RANGES)}")
+    args = ap.parse_args()
+
+    sizes = [int(s) for s in args.sizes.split(",")]
+    ranges = [r for name in args.ranges.split(",") for r in RANGES[name]]
+
+    image, fonts = build(args.font, sizes, ranges)
+
+    for size, line_height, _, glyphs in fonts:
+        print(f"{size}px: {len(glyphs)} glyphs, line height {line_height}")
+
+    print(f"{len(image)} bytes ({100 * len(image) / PARTITION_SIZE:.1f}% of partition)")
+
+    if len(image) > PARTITION_SIZE:
+        sys.exit("image does not fit the font partition")
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""Compare how fast calls arrive over the LAN multicast path and over MQTT.
+
+Runs on a Linux host on the pagers' subnet. It subscribes to the broker and
+joins the multicast group like a pager would, checks the LAN signature with
+the fleet's DAMPPI_LAN_KEY, and times when each call id shows up on each
+path. Calls come from pressing the pagers, or from POST /api/call with
+--press:
+
+    python tools/pathlat.py --broker 192.168.0.2 --key <DAMPPI_LAN_KEY> --press 192.168.0.10 -n 20 -i 12
+
+Prints one JSON line per call and a summary with how often each path came
+first and how far MQTT trailed the LAN path. Only the standard library is used.
+"""
+
+import argparse
+import hashlib
+import hmac
+import json
+import os
+import socket
+import statistics
+import struct
+import threading
+import time
+import urllib.error
+import urllib.request
+
+CHANNEL = "channel/0"
+GROUP = "239.255.68.80"
+PORT = 24680
+MAGIC = b"DMP2"
+TAG_LEN = 16
+HDR = struct.Struct(">4s6sIIB")
+
+
+def mqtt_string(s):
+    b = s.encode()
+    return struct.pack(">H", len(b)) + b
+
+
+def mqtt_packet(kind, body):
+    length = len(body)
+    encoded = bytearray()
+
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | (0x80 if length else 0))
+        if not length:
+            break
+
+    return bytes([kind]) + bytes(encoded) + body
+
+
+def recv_exact(sock, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise ConnectionError("broker closed the connection")
+        buf += chunk
+    return buf
+
+
+def mqtt_read(sock):
+    kind = recv_exact(sock, 1)[0]
+    length = shift = 0
+
+    while True:
+        byte = recv_exact(sock, 1)[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+
+    return kind, recv_exact(sock, length)
+
+
+def mqtt_subscribe(host, port):
+    sock = socket.create_connection((host, port), timeout=10)
+    client_id = "pathlat-" + os.urandom(4).hex()
+    # keepalive 0: the broker never expects a ping
+    body = mqtt_string("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 0) + mqtt_string(client_id)
+    sock.sendall(mqtt_packet(0x10, body))
+
+    kind, body = mqtt_read(sock)
+    if kind != 0x20 or body[1] != 0:
+        raise ConnectionError("broker refused connection")
+
+    sock.sendall(mqtt_packet(0x82, struct.pack(">H", 1) + mqtt_string(CHANNEL + "/#") + bytes([0])))
+    sock.settimeout(None)
+    return sock
+
+
+def parse_payload(topic, payload):
+    """(mac, seq) of a call, from the payload after the name or from an older build's topic."""
+    _, _, ident = payload.partition(b"\0")
+
+    if not ident and topic.startswith(CHANNEL + "/"):
+        ident = topic[len(CHANNEL) + 1:].encode()
+
+    mac, _, seq = ident.decode(errors="replace").partition("/")
+    return (mac.upper(), int(seq)) if len(mac) == 12 and seq.isdigit() else None
+
+
+class Arrivals:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.calls = {}
+        self.bad_signature = 0
+
+    def seen(self, ident, path):
+        now = time.monotonic()
+
+        with self.lock:
+            paths = self.calls.setdefault(ident, {})
+            paths.setdefault(path, now)
+
+            if len(paths) == 2:
+                print(json.dumps({"mac": ident[0], "seq": ident[1], "mqtt_minus_lan_ms":
+                                  round((paths["mqtt"] - paths["lan"]) * 1000, 1)}))
+
+
+def mqtt_reader(sock, arrivals):
+    while True:
+        kind, body = mqtt_read(sock)
+
+        if kind >> 4 != 3:
+            continue
+
+        topic_len, = struct.unpack_from(">H", body)
+        topic = body[2:2 + topic_len].decode(errors="replace")
+        # QoS 1 and 2 carry a packet id after the topic
+        payload = body[2 + topic_len + (2 if kind & 0x06 else 0):]
+        ident = parse_payload(topic, payload)
+
+        if ident:
+            arrivals.seen(ident, "mqtt")
+
+
+def lan_reader(sock, key, arrivals):
+    while True:
+        data = sock.recv(256)
+
+        if len(data) < HDR.size + TAG_LEN or data[:4] != MAGIC:
+            continue
+
+        tag = hmac.new(key, data[:-TAG_LEN], hashlib.sha256).digest()[:TAG_LEN]
+
+        if not hmac.compare_digest(tag, data[-TAG_LEN:]):
+            arrivals.bad_signature += 1
+            continue
+
+        _, mac, _, seq, _ = HDR.unpack_from(data)
+        arrivals.seen((mac.hex().upper(), seq), "lan")
+
+
+def lan_join():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", PORT))
+    mreq = struct.pack("4s4s", socket.inet_aton(GROUP), socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    return sock
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--broker", required=True)
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--key", required=True, help="DAMPPI_LAN_KEY of the fleet")
+    ap.add_argument("--press", help="pager to send calls from with POST /api/call; otherwise press the pagers")
+    ap.add_argument("-n", "--count", type=int, default=20, help="calls to send with --press")
+    ap.add_argument("-i", "--interval", type=float, default=12.0, help="seconds between calls with --press")
+    ap.add_argument("--seconds", type=float, default=60, help="how long to listen without --press")
+    args = ap.parse_args()
+
+    arrivals = Arrivals()
+    threading.Thread(target=mqtt_reader, args=(mqtt_subscribe(args.broker, args.port), arrivals), daemon=True).start()
+    threading.Thread(target=lan_reader, args=(lan_join(), args.key.encode(), arrivals), daemon=True).start()
+
+    throttled = 0
+
+    if args.press:
+        press = urllib.request.Request(f"http://{args.press}/api/call", method="POST")
+
+        for _ in range(args.count):
+            try:
+                urllib.request.urlopen(press, timeout=5)
+            except urllib.error.HTTPError as e:
+                if e.code != 429:
+                    raise
+                throttled += 1
+
+            time.sleep(args.interval)
+    else:
+        time.sleep(args.seconds)
+
+    time.sleep(2)
+
+    with arrivals.lock:
+        calls = list(arrivals.calls.values())
+
+    both = [c for c in calls if len(c) == 2]
+    deltas = sorted((c["mqtt"] - c["lan"]) * 1000 for c in both)
+    result = {
+        "calls": len(calls),
+        "lan_only": sum(1 for c in calls if list(c) == ["lan"]),
+        "mqtt_only": sum(1 for c in calls if list(c) == ["mqtt"]),
+        "lan_first": sum(1 for d in deltas if d > 0),
+        "mqtt_first": sum(1 for d in deltas if d <= 0),
+        "bad_signature": arrivals.bad_signature,
+        "throttled": throttled,
+    }
+
+    if deltas:
+        result.update(
+            mqtt_minus_lan_median_ms=round(statistics.median(deltas), 1),
+            mqtt_minus_lan_p95_ms=round(deltas[int(0.95 * (len(deltas) - 1))], 1),
+        )
+
+    print(json.dumps(result))
+
+
+if __name__ == "__main__":
+    main()
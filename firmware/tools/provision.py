@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+"""Provision pagers in bulk from a CSV, so they skip the SoftAP setup.
+
+Every row of the fleet CSV becomes an image of the "fctry" NVS partition with
+the same keys the configuration page saves. On first boot, and after a
+factory reset, the pager copies them into its own NVS and comes up online.
+Each image carries a new stamp, so a unit that is flashed again replaces the
+configuration it had with the one in the image.
+
+    name,ssid,pass,ssid1,pass1,ssid2,pass2,server,ca,mac
+    Front desk,Office,secret,,,,,192.168.0.2,,
+    Kitchen,Office,secret,Backup,secret2,,,192.168.0.2,certs/ca.pem,40:4c:ca:12:34:56
+
+Only name, ssid, pass and server are required. ca is the path of a broker CA
+in PEM. mac binds a row to one unit; rows without it go to the next unit that
+is plugged in. Images and the ledger name a unit by its mac, else by an
+optional id column, else by its name, and each must be unique in the CSV.
+
+    python tools/provision.py build fleet.csv --out provision
+    python tools/provision.py flash fleet.csv --out provision --port /dev/ttyACM0
+
+build writes one image per row. flash takes units on one port, one after
+another. For each unit it reads the MAC, picks its row, writes the firmware
+from build/flash_args together with the unit's image, and records it in
+<out>/provisioned.csv so that a restarted station skips both the row and the
+unit. Both commands print the time per unit and the throughput per station as
+JSON.
+
+Needs ESP-IDF's environment (IDF_PATH, esptool.py) for the image generator and flashing.
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+KEYS = ["ssid", "pass", "ssid1", "pass1", "ssid2", "pass2", "name", "server", "ca"]
+REQUIRED = ["name", "ssid", "pass", "server"]
+
+FIRMWARE = os.path.join(os.path.dirname(__file__), "..")
+PARTITION = "fctry"
+
+
+def partition(table):
+    """Offset and size of the factory partition from the partition table."""
+    with open(table) as f:
+        for line in f:
+            cols = [c.strip() for c in line.split("#")[0].split(",")]
+
+            if cols[0] == PARTITION:
+                return int(cols[3], 0), int(cols[4], 0)
+
+    sys.exit(f"{table}: no {PARTITION} partition")
+
+
+def generator():
+    idf = os.environ.get("IDF_PATH")
+
+    if not idf:
+        sys.exit("IDF_PATH is not set, run this from an ESP-IDF shell")
+
+    return os.path.join(idf, "components", "nvs_flash", "nvs_partition_generator", "nvs_partition_gen.py")
+
+
+def unit_id(row):
+    key = row.get("mac") or (row.get("id") or "").strip() or row["name"]
+    return re.sub(r"[^0-9A-Za-z_-]+", "_", key).strip("_")
+
+
+def load(path):
+    with open(path, newline="") as f:
+        rows = list(csv.DictReader(f))
+
+    for n, row in enumerate(rows, 2):
+        missing = [k for k in REQUIRED if not (row.get(k) or "").strip()]
+
+        if missing:
+            sys.exit(f"{path}:{n}: missing {', '.join(missing)}")
+
+        for k in KEYS[:-1]:
+            if len((row.get(k) or "").encode()) > (15 if k == "server" else 31):
+                sys.exit(f"{path}:{n}: {k} is too long")
+
+        if row.get("mac"):
+            row["mac"] = row["mac"].strip().lower()
+
+    # two rows with one id would overwrite each other's image and look done in the ledger after the first
+    seen = {}
+
+    for n, row in enumerate(rows, 2):
+        unit = unit_id(row)
+
+        if not unit:
+            sys.exit(f"{path}:{n}: no usable mac, id or name to tell this unit apart")
+
+        if unit in seen:
+            sys.exit(f"{path}:{n}: same unit id {unit!r} as line {seen[unit]}; add a mac or an id column")
+
+        seen[unit] = n
+
+    return rows
+
+
+def build_one(row, out, size):
+    base = os.path.join(out, unit_id(row))
+
+    with open(base + ".csv", "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(["key", "type", "encoding", "value"])
+        w.writerow(["cfg", "namespace", "", ""])
+
+        for k in KEYS:
+            value = (row.get(k) or "").strip()
+
+            if k == "ca" and value:
+                w.writerow([k, "file", "string", os.path.abspath(value)])
+            elif value or k != "ca":
+                w.writerow([k, "data", "string", value])
+
+        # flashing leaves the unit's own NVS as it was; a stamp it has not seen tells it to replace that config
+        w.writerow(["sys", "namespace", "", ""])
+        w.writerow(["stamp", "data", "string", f"{unit_id(row)[:40]}-{int(time.time())}"])
+
+    subprocess.run([sys.executable, generator(), "generate", base + ".csv", base + ".bin", hex(size)], check=True,
+                   stdout=subprocess.DEVNULL)
+    return base + ".bin"
+
+
+def read_mac(port):
+    out = subprocess.run(["esptool.py", "--port", port, "read_mac"], capture_output=True, text=True)
+    m = re.search(r"MAC:\s*([0-9a-f:]{17})", out.stdout)
+    return m.group(1) if m else None
+
+
+def summary(command, times, extra=None):
+    total = sum(times)
+    result = {
+        "command": command,
+        "units": len(times),
+        "seconds": round(total, 2),
+        "per_unit_s": round(total / len(times), 2) if times else None,
+        "units_per_hour": round(3600 * len(times) / total, 1) if total else None,
+    }
+    result.update(extra or {})
+    print(json.dumps(result))
+
+
+def build(args):
+    rows = load(args.csv)
+    _, size = partition(args.partitions)
+    os.makedirs(args.out, exist_ok=True)
+
+    times = []
+
+    for row in rows:
+        start = time.monotonic()
+        build_one(row, args.out, size)
+        times.append(time.monotonic() - start)
+
+    summary("build", times)
+
+
+def flash(args):
+    rows = load(args.csv)
+    offset, size = partition(args.partitions)
+    os.makedirs(args.out, exist_ok=True)
+
+    ledger = os.path.join(args.out, "provisioned.csv")
+    done = set()
+    macs = set()
+
+    if os.path.exists(ledger):
+        with open(ledger, newline="") as f:
+            for r in csv.DictReader(f):
+                done.add(r["unit"])
+                macs.add(r["mac"])
+
+    times = []
+
+    while any(unit_id(r) not in done for r in rows):
+        try:
+            input("connect the next unit and press enter (ctrl-c to stop) ")
+        except (KeyboardInterrupt, EOFError):
+            print(file=sys.stderr)
+            break
+
+        start = time.monotonic()
+        mac = read_mac(args.port)
+
+        if not mac:
+            print(f"no unit found on {args.port}", file=sys.stderr)
+            continue
+
+        # a unit plugged in twice would otherwise take the next unbound row and two rows would share one device
+        if mac in macs:
+            print(f"{mac} is already provisioned, skipping it", file=sys.stderr)
+            continue
+
+        # a row bound to this MAC wins, otherwise the next row that is not bound to any unit
+        pending = [r for r in rows if unit_id(r) not in done]
+        row = next((r for r in pending if r.get("mac") == mac), None) or next(
+            (r for r in pending if not r.get("mac")), None)
+
+        if not row:
+            print(f"no row left for {mac}", file=sys.stderr)
+            continue
+
+        image = build_one(row, args.out, size)
+
+        subprocess.run(["esptool.py", "--port", args.port, "--baud", str(args.baud), "write_flash",
+                        "@" + os.path.join(args.build, "flash_args"), hex(offset), image], check=True,
+                       cwd=args.build)
+
+        elapsed = time.monotonic() - start
+        times.append(elapsed)
+        done.add(unit_id(row))
+        macs.add(mac)
+
+        new = not os.path.exists(ledger)
+
+        with open(ledger, "a", newline="") as f:
+            w = csv.writer(f)
+
+            if new:
+                w.writerow(["unit", "name", "mac", "seconds"])
+
+            w.writerow([unit_id(row), row["name"], mac, round(elapsed, 1)])
+
+        print(json.dumps({"unit": row["name"], "mac": mac, "seconds": round(elapsed, 1)}))
+
+    summary("flash", times, {"port": args.port, "baud": args.baud})
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    for name in ("build", "flash"):
+        p = sub.add_parser(name)
+        p.add_argument("csv", help="fleet CSV, one row per unit")
+        p.add_argument("--out", default="provision", help="directory for the images and the ledger")
+        p.add_argument("--partitions", default=os.path.join(FIRMWARE, "partitions.csv"))
+
+        if name == "flash":
+            p.add_argument("--port", required=True)
+            p.add_argument("--baud", type=int, default=921600)
+            p.add_argument("--build", default=os.path.join(FIRMWARE, "build"), help="firmware build directory")
+
+    args = parser.parse_args()
+    build(args) if args.command == "build" else flash(args)
+
+
+if __name__ == "__main__":
+    main()